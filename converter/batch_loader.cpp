@@ -0,0 +1,62 @@
+// clang-format off
+
+// Batch loader shared library for the trainer, loaded with ctypes by trainer/batch_loader.py
+// Build from the converter folder with
+// clang++ -std=c++20 -O3 -march=native -shared -fPIC batch_loader.cpp -o batch_loader.so
+// See batch_loader.hpp for the batch layout
+
+#include "batch_loader.hpp"
+
+extern "C" {
+
+// Returns nullptr if the file can't be opened or has less than 1 batch
+BatchLoader* loaderOpen(const char *fileName, int format, u64 batchSize, int numThreads, int numSlots,
+                        int shuffle, u64 seed, int compactOutputs)
+{
+    static bool initialized = false;
+    if (!initialized) {
+        initUtils();
+        attacks::init();
+        initialized = true;
+    }
+
+    BatchLoader *loader = new BatchLoader();
+    if (!loader->open(fileName, (DataFormat)format, batchSize, numThreads, numSlots, shuffle, seed, compactOutputs)) {
+        delete loader;
+        return nullptr;
+    }
+
+    return loader;
+}
+
+void loaderClose(BatchLoader *loader) { delete loader; }
+
+u64 loaderNumEntries(BatchLoader *loader) { return loader->numEntries(); }
+
+u64 loaderNumBatchesPerEpoch(BatchLoader *loader) { return loader->numBatchesPerEpoch(); }
+
+int loaderMaxActiveInputs() { return MAX_ACTIVE_INPUTS; }
+
+int loaderMaxTargets() { return MAX_TARGETS; }
+
+int loaderOutputSize(BatchLoader *loader) { return loader->outputSize(); }
+
+int loaderNext(BatchLoader *loader) { return loader->next(); }
+
+void loaderRelease(BatchLoader *loader, int slotIdx) { loader->release(slotIdx); }
+
+i64* loaderInputs(BatchLoader *loader, int slotIdx) { return loader->slot(slotIdx).inputs.data(); }
+
+u8* loaderLegal(BatchLoader *loader, int slotIdx) { return loader->slot(slotIdx).legal.data(); }
+
+i64* loaderBestMoves(BatchLoader *loader, int slotIdx) { return loader->slot(slotIdx).bestMoves.data(); }
+
+i64* loaderTargetMoves(BatchLoader *loader, int slotIdx) { return loader->slot(slotIdx).targetMoves.data(); }
+
+float* loaderTargetProbs(BatchLoader *loader, int slotIdx) { return loader->slot(slotIdx).targetProbs.data(); }
+
+float* loaderResults(BatchLoader *loader, int slotIdx) { return loader->slot(slotIdx).results.data(); }
+
+float* loaderEvals(BatchLoader *loader, int slotIdx) { return loader->slot(slotIdx).evals.data(); }
+
+} // extern "C"
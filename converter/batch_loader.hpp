@@ -0,0 +1,377 @@
+#pragma once
+
+// clang-format off
+
+// Batch loader used by the trainer through batch_loader.cpp, and by the native trainer directly
+//
+// Background threads read, shuffle and decode entries straight into preallocated batch slots:
+//     inputs       i64 [batchSize][32]          active inputs, padded with 768
+//     legal        u8  [batchSize][outputSize]  1 if the move is legal
+//     legalMoves   i16 [batchSize][218]         legal moves, padded with outputSize
+//     bestMoves    i64 [batchSize]
+//     targetMoves  i64 [batchSize][218]         moves with visit targets, padded with outputSize
+//     targetProbs  f32 [batchSize][218]         their probabilities, summing to 1
+//     results      f32 [batchSize]              game result from stm perspective, 0 if unknown
+//     evals        f32 [batchSize]              value net eval label in centipawns from stm perspective, 0 if unlabelled
+// Moves are policy output indexes: moves4096 with outputSize 4096, or compact indexes with outputSize 1792
+// if opened with compactOutputs (see policy_outputs.hpp)
+// Without visits in the data, the only target is the best move with probability 1
+// Compressed files are shuffled by blocks, so they should be shuffled with the shuffle tool beforehand
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <random>
+#include "board.hpp"
+#include "data_format.hpp"
+#include "input_file.hpp"
+#include "policy_outputs.hpp"
+
+constexpr int MAX_ACTIVE_INPUTS = 32, MAX_MOVES = 218, MAX_TARGETS = 218;
+
+struct BatchSlot {
+    std::vector<i64> inputs, bestMoves, targetMoves;
+    std::vector<u8> legal;
+    std::vector<i16> legalMoves;
+    std::vector<float> targetProbs, results, evals;
+    i64 batchIdx = -1; // -1 if free
+    bool ready = false;
+};
+
+// Order of the entries in an epoch, or of the blocks for the compressed format
+struct EpochOrder {
+    std::vector<u64> order = {};
+    std::vector<u64> blocksFirstEntry = {}; // Only for the compressed format, epoch entry index of each block in order
+};
+
+class BatchLoader {
+    private:
+
+    InputFile mFile;
+    DataFormat mFormat;
+    std::vector<u64> mEntriesOffsets = {}; // Only for variable size formats
+    std::vector<CompressedBlock> mBlocks = {}; // Only for the compressed format
+    u64 mNumEntries = 0, mEntrySize = 0;
+    u64 mBatchSize;
+    bool mShuffle;
+    bool mCompactOutputs;
+    u64 mSeed;
+
+    std::vector<BatchSlot> mSlots;
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mSlotFreed, mSlotReady;
+    bool mStop = false;
+
+    // Guarded by mMutex
+    i64 mNextBatchToLoad = 0, mNextBatchToReturn = 0;
+    i64 mEpochOrderEpoch = -1;
+    std::shared_ptr<const EpochOrder> mEpochOrder;
+
+    public:
+
+    inline bool open(std::string fileName, DataFormat format, u64 batchSize, int numThreads, int numSlots,
+                     bool shuffle, u64 seed, bool compactOutputs = false)
+    {
+        if (!mFile.open(fileName)) return false;
+
+        mFormat = format;
+        mBatchSize = batchSize;
+        mShuffle = shuffle;
+        mSeed = seed;
+        mCompactOutputs = compactOutputs;
+
+        if (format == DataFormat::COMPRESSED) {
+            CompressedHeader header;
+            if (!readCompressedIndex(mFile.data(), mFile.size(), header, mBlocks)) return false;
+            mNumEntries = header.numEntries;
+        }
+        else if (isFixedSize(format)) {
+            mEntrySize = entrySize(mFile.data(), format);
+            mNumEntries = mFile.size() / mEntrySize;
+        }
+        else {
+            // Variable size entries are indexed once
+            for (u64 offset = 0; offset < mFile.size(); offset += entrySize(mFile.data() + offset, format))
+                mEntriesOffsets.push_back(offset);
+
+            mNumEntries = mEntriesOffsets.size();
+        }
+
+        if (numBatchesPerEpoch() == 0) return false;
+
+        mSlots.resize(max(numSlots, 1));
+        for (BatchSlot &slot : mSlots) {
+            slot.inputs.resize(batchSize * MAX_ACTIVE_INPUTS);
+            slot.legal.resize(batchSize * outputSize());
+            slot.legalMoves.resize(batchSize * MAX_MOVES);
+            slot.bestMoves.resize(batchSize);
+            slot.targetMoves.resize(batchSize * MAX_TARGETS);
+            slot.targetProbs.resize(batchSize * MAX_TARGETS);
+            slot.results.resize(batchSize);
+            slot.evals.resize(batchSize);
+        }
+
+        for (int i = 0; i < max(numThreads, 1); i++)
+            mThreads.emplace_back([this]() { worker(); });
+
+        return true;
+    }
+
+    inline ~BatchLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mSlotFreed.notify_all();
+
+        for (std::thread &thread : mThreads)
+            thread.join();
+    }
+
+    inline u64 numEntries() { return mNumEntries; }
+
+    inline u64 numBatchesPerEpoch() { return mNumEntries / mBatchSize; }
+
+    inline BatchSlot& slot(int slotIdx) { return mSlots[slotIdx]; }
+
+    inline int outputSize() { return mCompactOutputs ? OUTPUT_SIZE_COMPACT : OUTPUT_SIZE_4096; }
+
+    inline i16 outputIdx(u16 move4096) {
+        return mCompactOutputs ? COMPACT_OUTPUT_IDXS[move4096] : move4096;
+    }
+
+    // Blocks until the next batch is loaded and returns its slot index
+    // Batches are returned in order, epoch after epoch
+    inline int next()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        while (true) {
+            for (int i = 0; i < mSlots.size(); i++)
+                if (mSlots[i].ready && mSlots[i].batchIdx == mNextBatchToReturn) {
+                    mNextBatchToReturn++;
+                    mSlotFreed.notify_all(); // Workers may load 1 more batch ahead
+                    return i;
+                }
+
+            mSlotReady.wait(lock);
+        }
+    }
+
+    // The slot's buffers can be reused once the caller is done with them
+    inline void release(int slotIdx)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mSlots[slotIdx].batchIdx = -1;
+            mSlots[slotIdx].ready = false;
+        }
+        mSlotFreed.notify_all();
+    }
+
+    private:
+
+    inline void worker()
+    {
+        std::vector<Move> moves = {};
+
+        while (true)
+        {
+            int slotIdx = -1;
+            i64 batchIdx;
+            std::shared_ptr<const EpochOrder> epochOrder;
+
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+
+                // Batches are only loaded a few slots ahead of the consumer, so next() never waits
+                // on a batch whose slot was taken by a later one
+                mSlotFreed.wait(lock, [&]() {
+                    if (mStop) return true;
+                    if (mNextBatchToLoad >= mNextBatchToReturn + (i64)mSlots.size()) return false;
+
+                    for (int i = 0; i < mSlots.size(); i++)
+                        if (mSlots[i].batchIdx == -1) {
+                            slotIdx = i;
+                            return true;
+                        }
+
+                    return false;
+                });
+
+                if (mStop) return;
+
+                batchIdx = mNextBatchToLoad++;
+                mSlots[slotIdx].batchIdx = batchIdx;
+
+                // New order of entries every epoch
+                i64 epoch = batchIdx / numBatchesPerEpoch();
+                if (epoch != mEpochOrderEpoch)
+                {
+                    auto newEpochOrder = std::make_shared<EpochOrder>();
+                    bool compressed = mFormat == DataFormat::COMPRESSED;
+
+                    newEpochOrder->order.resize(compressed ? mBlocks.size() : mNumEntries);
+                    for (u64 i = 0; i < newEpochOrder->order.size(); i++)
+                        newEpochOrder->order[i] = i;
+
+                    if (mShuffle) {
+                        std::mt19937_64 rng(mSeed + epoch);
+                        std::shuffle(newEpochOrder->order.begin(), newEpochOrder->order.end(), rng);
+                    }
+
+                    if (compressed) {
+                        u64 numEntries = 0;
+                        for (u64 blockIdx : newEpochOrder->order) {
+                            newEpochOrder->blocksFirstEntry.push_back(numEntries);
+                            numEntries += mBlocks[blockIdx].numEntries;
+                        }
+                    }
+
+                    mEpochOrder = newEpochOrder;
+                    mEpochOrderEpoch = epoch;
+                }
+
+                epochOrder = mEpochOrder;
+            }
+
+            BatchSlot &slot = mSlots[slotIdx];
+            u64 firstEntry = (batchIdx % numBatchesPerEpoch()) * mBatchSize;
+
+            if (mFormat == DataFormat::COMPRESSED)
+                loadCompressedBatch(slot, firstEntry, *epochOrder);
+            else
+                for (u64 i = 0; i < mBatchSize; i++)
+                    loadEntry(slot, i, epochOrder->order[firstEntry + i], moves);
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                slot.ready = true;
+            }
+            mSlotReady.notify_all();
+        }
+    }
+
+    inline void loadEntry(BatchSlot &slot, u64 i, u64 entryIdx, std::vector<Move> &moves)
+    {
+        DataEntry entry = DataEntry();
+        std::vector<std::pair<u16, float>> targets = {};
+        float result = 0, eval = 0;
+
+        if (isFixedSize(mFormat))
+        {
+            const char *data = mFile.data() + entryIdx * mEntrySize;
+            PackedEntry packedEntry;
+            memcpy(&packedEntry, data, sizeof(PackedEntry));
+
+            entry = packedEntry.decode(moves);
+            result = packedEntry.result;
+            eval = packedEntry.eval;
+
+            if (mFormat == DataFormat::PACKED_WITH_VISITS)
+            {
+                PackedVisits packedVisits;
+                memcpy(&packedVisits, data + sizeof(PackedEntry), sizeof(PackedVisits));
+
+                for (int j = 0; j < PACKED_VISIT_TARGETS; j++)
+                    if (packedVisits.moves4096[j] < 4096 && packedVisits.visits[j] > 0)
+                        targets.push_back({ packedVisits.moves4096[j], packedVisits.visits[j] });
+            }
+        }
+        else {
+            const char *data = mFile.data() + mEntriesOffsets[entryIdx];
+
+            auto read = [&](void *dst, u64 numBytes) {
+                memcpy(dst, data, numBytes);
+                data += numBytes;
+            };
+
+            read(&entry.stm, 1);
+            read(&entry.numActiveInputs, 1);
+            read(entry.activeInputs.data(), 2 * entry.numActiveInputs);
+            read(&entry.numMoves, 1);
+            read(entry.moves4096.data(), 2 * entry.numMoves);
+            read(&entry.bestMove4096, 2);
+
+            if (mFormat == DataFormat::DATA_ENTRY_WITH_VISITS)
+            {
+                std::array<u16, 218> visits;
+                read(visits.data(), 2 * entry.numMoves);
+
+                for (int j = 0; j < entry.numMoves; j++)
+                    if (visits[j] > 0)
+                        targets.push_back({ (u16)entry.moves4096[j], visits[j] });
+
+                i8 gameResult;
+                read(&gameResult, 1);
+                result = gameResult;
+            }
+        }
+
+        fillSlot(slot, i, entry, targets, result, eval);
+    }
+
+    // Entries of compressed files are only reachable by decompressing their block, so a batch is
+    // the consecutive entries of the blocks in epoch order covering it
+    inline void loadCompressedBatch(BatchSlot &slot, u64 firstEntry, const EpochOrder &epochOrder)
+    {
+        const std::vector<u64> &blocksFirstEntry = epochOrder.blocksFirstEntry;
+        u64 orderIdx = std::upper_bound(blocksFirstEntry.begin(), blocksFirstEntry.end(), firstEntry)
+                       - blocksFirstEntry.begin() - 1;
+        u64 entryIdx = blocksFirstEntry[orderIdx];
+
+        DataEntry entry = DataEntry();
+        std::vector<std::pair<u16, float>> targets = {};
+
+        for (u64 i = 0; i < mBatchSize; orderIdx++)
+        {
+            const CompressedBlock &block = mBlocks[epochOrder.order[orderIdx]];
+            const u8 *data = reinterpret_cast<const u8*>(mFile.data() + block.offset);
+
+            for (u32 j = 0; j < block.numEntries && i < mBatchSize; j++, entryIdx++)
+            {
+                decompressEntry(data, entry);
+
+                if (entryIdx >= firstEntry) {
+                    targets.clear();
+                    fillSlot(slot, i++, entry, targets, 0, 0);
+                }
+            }
+        }
+    }
+
+    inline void fillSlot(BatchSlot &slot, u64 i, DataEntry &entry, std::vector<std::pair<u16, float>> &targets,
+                         float result, float eval)
+    {
+        for (int j = 0; j < MAX_ACTIVE_INPUTS; j++)
+            slot.inputs[i * MAX_ACTIVE_INPUTS + j] = j < entry.numActiveInputs ? entry.activeInputs[j] : 768;
+
+        u8 *legal = &slot.legal[i * outputSize()];
+        memset(legal, 0, outputSize());
+        for (int j = 0; j < entry.numMoves; j++)
+            legal[outputIdx(entry.moves4096[j])] = 1;
+
+        for (int j = 0; j < MAX_MOVES; j++)
+            slot.legalMoves[i * MAX_MOVES + j] = j < entry.numMoves ? outputIdx(entry.moves4096[j]) : outputSize();
+
+        slot.bestMoves[i] = outputIdx(entry.bestMove4096);
+        slot.results[i] = result;
+        slot.evals[i] = eval;
+
+        if (targets.size() == 0)
+            targets.push_back({ entry.bestMove4096, 1 });
+
+        float totalVisits = 0;
+        for (auto [move4096, visits] : targets)
+            totalVisits += visits;
+
+        for (int j = 0; j < MAX_TARGETS; j++) {
+            slot.targetMoves[i * MAX_TARGETS + j] = j < targets.size() ? outputIdx(targets[j].first) : outputSize();
+            slot.targetProbs[i * MAX_TARGETS + j] = j < targets.size() ? targets[j].second / totalVisits : 0;
+        }
+    }
+};
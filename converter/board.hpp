@@ -3,11 +3,36 @@
 // clang-format off
 #include <random>
 #include <cstring> // for memset()
+#include <charconv> // for std::from_chars()
 #include "types.hpp"
 #include "utils.hpp"
 #include "move.hpp"
 #include "attacks.hpp"
 
+// Same keys as the engine, so hashes match
+std::array<u64, 2> ZOBRIST_COLOR; // [color]
+std::array<std::array<std::array<u64, 64>, 6>, 2> ZOBRIST_PIECES; // [color][pieceType][square]
+std::array<u64, 8> ZOBRIST_FILES; // [file]
+
+inline void initZobrist()
+{
+    std::mt19937_64 gen(12345); // 64 bit Mersenne Twister rng with seed 12345
+    std::uniform_int_distribution<u64> distribution; // distribution(gen) returns random u64
+
+    ZOBRIST_COLOR[0] = distribution(gen);
+    ZOBRIST_COLOR[1] = distribution(gen);
+
+    for (int pt = 0; pt < 6; pt++)
+        for (int sq = 0; sq < 64; sq++)
+        {
+            ZOBRIST_PIECES[(int)Color::WHITE][pt][sq] = distribution(gen);
+            ZOBRIST_PIECES[(int)Color::BLACK][pt][sq] = distribution(gen);
+        }
+
+    for (int file = 0; file < 8; file++)
+        ZOBRIST_FILES[file] = distribution(gen);
+}
+
 struct BoardState
 {
     private:
@@ -23,22 +48,39 @@ struct BoardState
 
     inline BoardState() = default;
 
-    inline BoardState(std::string fen)
+    // Parses without allocating, since the converter parses billions of fens
+    inline BoardState(std::string_view fen)
     {
-        trim(fen);
-        std::vector<std::string> fenSplit = splitString(fen, ' ');
+        // Returns the next space separated field of the fen
+        auto nextField = [&]() -> std::string_view {
+            while (fen.size() > 0 && isspace(fen[0])) 
+                fen.remove_prefix(1);
+
+            size_t fieldSize = 0;
+            while (fieldSize < fen.size() && !isspace(fen[fieldSize]))
+                fieldSize++;
+
+            std::string_view field = fen.substr(0, fieldSize);
+            fen.remove_prefix(fieldSize);
+            return field;
+        };
+
+        std::string_view fenRows = nextField();
+        std::string_view fenColor = nextField();
+        std::string_view fenCastlingRights = nextField();
+        std::string_view strEnPassantSquare = nextField();
+        std::string_view fenPliesSincePawnOrCapture = nextField();
+        std::string_view fenMoveCounter = nextField();
 
         // Parse color to move
-        mColorToMove = fenSplit[1] == "b" ? Color::BLACK : Color::WHITE;
+        mColorToMove = fenColor == "b" ? Color::BLACK : Color::WHITE;
 
         // Parse pieces
         memset(mColorBitboard.data(), 0, sizeof(mColorBitboard));
         memset(mPiecesBitboards.data(), 0, sizeof(mPiecesBitboards));
-        std::string fenRows = fenSplit[0];
         int currentRank = 7, currentFile = 0; // iterate ranks from top to bottom, files from left to right
-        for (int i = 0; i < fenRows.length(); i++)
+        for (char thisChar : fenRows)
         {
-            char thisChar = fenRows[i];
             if (thisChar == '/') {
                 currentRank--;
                 currentFile = 0;
@@ -47,7 +89,7 @@ struct BoardState
                 currentFile += charToInt(thisChar);
             else {
                 Color color = isupper(thisChar) ? Color::WHITE : Color::BLACK;
-                PieceType pt = CHAR_TO_PIECE_TYPE[thisChar];
+                PieceType pt = charToPieceType(thisChar);
                 Square sq = currentRank * 8 + currentFile;
                 placePiece(color, pt, sq);
                 currentFile++;
@@ -56,11 +98,9 @@ struct BoardState
 
         // Parse castling rights
         mCastlingRights = 0;
-        std::string fenCastlingRights = fenSplit[2];
         if (fenCastlingRights != "-")  {
-            for (int i = 0; i < fenCastlingRights.length(); i++)
+            for (char thisChar : fenCastlingRights)
             {
-                char thisChar = fenCastlingRights[i];
                 Color color = isupper(thisChar) ? Color::WHITE : Color::BLACK;
                 int castlingRight = thisChar == 'K' || thisChar == 'k' 
                                     ? CASTLE_SHORT : CASTLE_LONG;
@@ -70,15 +110,31 @@ struct BoardState
 
         // Parse en passant target square
         mEnPassantSquare = SQUARE_NONE;
-        std::string strEnPassantSquare = fenSplit[3];
-        if (strEnPassantSquare != "-") {
+        if (strEnPassantSquare.size() >= 2)
             mEnPassantSquare = strToSquare(strEnPassantSquare);
-            int file = (int)squareFile(mEnPassantSquare);
-        }
 
         // Parse last 2 fen tokens
-        mPliesSincePawnOrCapture = fenSplit.size() >= 5 ? stoi(fenSplit[4]) : 0;
-        mMoveCounter = fenSplit.size() >= 6 ? stoi(fenSplit[5]) : 1;
+        auto parseNumber = [](std::string_view field, u16 defaultValue) -> u16 {
+            u16 number = defaultValue;
+            std::from_chars(field.data(), field.data() + field.size(), number);
+            return number;
+        };
+
+        mPliesSincePawnOrCapture = parseNumber(fenPliesSincePawnOrCapture, 0);
+        mMoveCounter = parseNumber(fenMoveCounter, 1);
+    }
+
+    // Builds a board from bitboards, e.g. when unpacking a PackedEntry
+    inline BoardState(Color stm, std::array<u64, 2> colorBitboards, std::array<u64, 6> piecesBitboards,
+                      u64 castlingRights, Square enPassantSquare, u8 pliesSincePawnOrCapture)
+    {
+        mColorToMove = stm;
+        mColorBitboard = colorBitboards;
+        mPiecesBitboards = piecesBitboards;
+        mCastlingRights = castlingRights;
+        mEnPassantSquare = enPassantSquare;
+        mPliesSincePawnOrCapture = pliesSincePawnOrCapture;
+        mMoveCounter = 1;
     }
 
     inline Color sideToMove() { return mColorToMove; }
@@ -149,6 +205,28 @@ struct BoardState
 
     inline auto pliesSincePawnOrCapture() { return mPliesSincePawnOrCapture; }
 
+    inline u64 castlingRights() { return mCastlingRights; }
+
+    inline Square enPassantSquare() { return mEnPassantSquare; }
+
+    // Computed from scratch, since converter boards are parsed once and never make moves
+    // Requires initZobrist()
+    inline u64 zobristHash()
+    {
+        u64 hash = ZOBRIST_COLOR[(int)mColorToMove] ^ mCastlingRights;
+
+        if (mEnPassantSquare != SQUARE_NONE)
+            hash ^= ZOBRIST_FILES[(int)squareFile(mEnPassantSquare)];
+
+        for (u64 occ = occupancy(); occ > 0; )
+        {
+            Square sq = poplsb(occ);
+            hash ^= ZOBRIST_PIECES[(int)colorAt(sq)][(int)pieceTypeAt(sq)][sq];
+        }
+
+        return hash;
+    }
+
     private:
 
     inline void placePiece(Color color, PieceType pieceType, Square square) {
@@ -408,7 +486,7 @@ struct BoardState
 
     inline void getMoves(std::vector<Move> &moves, bool underpromotions = true)
     {
-        moves = {};
+        moves.clear();
         u64 threats = this->threats();
 
         // King moves
@@ -606,7 +684,7 @@ struct BoardState
 
     public:
 
-    inline Move uciToMove(std::string uciMove)
+    inline Move uciToMove(std::string_view uciMove)
     {
         Move move = MOVE_NONE;
         Square from = strToSquare(uciMove.substr(0,2));
@@ -0,0 +1,157 @@
+#pragma once
+
+// clang-format off
+#include "data_entry.hpp"
+
+// Block compressed container of DataEntry entries, with no external dependencies
+//
+// File layout:
+//     CompressedHeader
+//     blocks, each one independently decompressible
+//     CompressedBlock index [numBlocks]
+//
+// Entries are encoded one after the other inside a block:
+//     u8 stm
+//     u8 numActiveInputs, activeInputs as varints of the deltas between sorted inputs
+//     u8 numMoves, moves4096 as varints of the deltas between sorted moves
+//     u8 index of the best move in moves4096, or 255 followed by u16 bestMove4096 if it's not there
+
+constexpr u32 COMPRESSED_MAGIC = 0x31424E43; // "CNB1"
+constexpr u64 COMPRESSED_BLOCK_ENTRIES = 1024;
+
+#pragma pack(push, 1)
+struct CompressedHeader {
+    public:
+
+    u32 magic = COMPRESSED_MAGIC;
+    u32 padding = 0;
+    u64 numEntries = 0;
+    u64 numBlocks = 0;
+    u64 indexOffset = 0; // Byte offset of the blocks index in the file
+};
+
+struct CompressedBlock {
+    public:
+
+    u64 offset = 0; // Byte offset of the block in the file
+    u32 numBytes = 0;
+    u32 numEntries = 0;
+};
+#pragma pack(pop)
+
+inline void writeVarint(std::vector<char> &out, u32 value)
+{
+    while (value >= 128) {
+        out.push_back((char)(value | 128));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+inline u32 readVarint(const u8 *&data)
+{
+    u32 value = *data & 127;
+    int shift = 7;
+
+    while (*data++ & 128) {
+        value |= (u32)(*data & 127) << shift;
+        shift += 7;
+    }
+
+    return value;
+}
+
+inline void compressEntry(const DataEntry &entry, std::vector<char> &out)
+{
+    out.push_back((char)entry.stm);
+
+    out.push_back((char)entry.numActiveInputs);
+    for (int i = 0; i < entry.numActiveInputs; i++)
+        writeVarint(out, entry.activeInputs[i] - (i > 0 ? entry.activeInputs[i - 1] : 0));
+
+    out.push_back((char)entry.numMoves);
+    for (int i = 0; i < entry.numMoves; i++)
+        writeVarint(out, entry.moves4096[i] - (i > 0 ? entry.moves4096[i - 1] : 0));
+
+    const i16 *bestMove = std::find(entry.moves4096.data(), entry.moves4096.data() + entry.numMoves, (i16)entry.bestMove4096);
+    u8 bestMoveIdx = bestMove - entry.moves4096.data();
+
+    if (bestMoveIdx < entry.numMoves)
+        out.push_back((char)bestMoveIdx);
+    else {
+        out.push_back((char)255);
+        out.insert(out.end(), reinterpret_cast<const char*>(&entry.bestMove4096),
+                   reinterpret_cast<const char*>(&entry.bestMove4096) + 2);
+    }
+}
+
+inline void decompressEntry(const u8 *&data, DataEntry &entry)
+{
+    entry.stm = (Color)*data++;
+
+    entry.numActiveInputs = *data++;
+    for (int i = 0; i < entry.numActiveInputs; i++)
+        entry.activeInputs[i] = readVarint(data) + (i > 0 ? entry.activeInputs[i - 1] : 0);
+
+    entry.numMoves = *data++;
+    for (int i = 0; i < entry.numMoves; i++)
+        entry.moves4096[i] = readVarint(data) + (i > 0 ? entry.moves4096[i - 1] : 0);
+
+    u8 bestMoveIdx = *data++;
+    if (bestMoveIdx != 255)
+        entry.bestMove4096 = entry.moves4096[bestMoveIdx];
+    else {
+        memcpy(&entry.bestMove4096, data, 2);
+        data += 2;
+    }
+}
+
+// Compresses the DataEntry entries of a converter output buffer, appending blocks to out and their info
+// to blocks, with offsets relative to the start of out
+inline void compressEntries(std::string_view entries, std::vector<char> &out, std::vector<CompressedBlock> &blocks)
+{
+    DataEntry entry = DataEntry();
+
+    while (entries.size() > 0)
+    {
+        CompressedBlock block = CompressedBlock();
+        block.offset = out.size();
+
+        while (entries.size() > 0 && block.numEntries < COMPRESSED_BLOCK_ENTRIES)
+        {
+            const char *data = entries.data();
+            auto read = [&](void *dst, u64 numBytes) {
+                memcpy(dst, data, numBytes);
+                data += numBytes;
+            };
+
+            read(&entry.stm, 1);
+            read(&entry.numActiveInputs, 1);
+            read(entry.activeInputs.data(), 2 * entry.numActiveInputs);
+            read(&entry.numMoves, 1);
+            read(entry.moves4096.data(), 2 * entry.numMoves);
+            read(&entry.bestMove4096, 2);
+
+            compressEntry(entry, out);
+            entries.remove_prefix(data - entries.data());
+            block.numEntries++;
+        }
+
+        block.numBytes = out.size() - block.offset;
+        blocks.push_back(block);
+    }
+}
+
+// Reads the header and blocks index of a compressed file, returns false if it isn't a valid one
+inline bool readCompressedIndex(const char *data, u64 size, CompressedHeader &header, std::vector<CompressedBlock> &blocks)
+{
+    if (size < sizeof(CompressedHeader)) return false;
+    memcpy(&header, data, sizeof(CompressedHeader));
+
+    if (header.magic != COMPRESSED_MAGIC || header.indexOffset + header.numBlocks * sizeof(CompressedBlock) > size)
+        return false;
+
+    blocks.resize(header.numBlocks);
+    memcpy(blocks.data(), data + header.indexOffset, header.numBlocks * sizeof(CompressedBlock));
+    return true;
+}
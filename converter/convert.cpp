@@ -1,56 +1,131 @@
 #include <fstream>
-#include <bit>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "board.hpp"
+#include "data_entry.hpp"
+#include "packed_entry.hpp"
+#include "input_file.hpp"
+#include "dedup_table.hpp"
+#include "compressed_file.hpp"
+#include "value_nnue.hpp"
 
-#pragma pack(push, 1)
-struct DataEntry {
-    public:
+enum class ConvertResult { CONVERTED, SKIPPED, DUPLICATE };
 
-    Color stm = Color::NONE;
-    u8 numActiveInputs = 0;
-    std::vector<i16> activeInputs = { };
-    u8 numMoves = 0;
-    std::vector<i16> moves4096 = { };
-    u16 bestMove4096 = 4096;
+// Converts a "fen|move" line and appends it to the output buffer, as a DataEntry or a PackedEntry
+// If dedupTable isn't null, positions already seen with the same best move are dropped
+// If labelValue, packed entries are labelled with the value net eval, so one pass serves both nets
+inline ConvertResult convertLine(std::string_view line, std::vector<Move> &moves, std::vector<char> &outBuffer,
+                                 bool packed, DedupTable *dedupTable, bool labelValue)
+{
+    size_t separatorIdx = line.find('|');
+    if (separatorIdx == std::string_view::npos) return ConvertResult::SKIPPED;
 
-    inline DataEntry() = default;
+    std::string_view fen = line.substr(0, separatorIdx);
+    std::string_view uciMove = line.substr(separatorIdx + 1);
 
-    inline std::string toString()
-    {
-        return "stm " + std::to_string((int)stm)
-               + " numActiveInputs " + std::to_string((int)numActiveInputs)
-               + "\nactiveInputs " + vecToString(activeInputs)
-               + "numMoves " +  std::to_string((int)numMoves)
-               + "\nmoves4096 " + vecToString(moves4096)
-               + "bestmove4096 " + std::to_string(bestMove4096);
-    }
+    while (uciMove.size() > 0 && isspace(uciMove.front())) uciMove.remove_prefix(1);
+    while (uciMove.size() > 0 && isspace(uciMove.back())) uciMove.remove_suffix(1);
+    if (uciMove.size() < 4) return ConvertResult::SKIPPED;
 
-    inline auto size()
-    {
-        return sizeof(stm) 
-               + sizeof(numActiveInputs) 
-               + 2 * activeInputs.size() 
-               + sizeof(numMoves) 
-               + 2 * moves4096.size() 
-               + sizeof(bestMove4096);
+    BoardState board = BoardState(fen);
+    Move bestMove = board.uciToMove(uciMove);
+
+    if (bestMove.promotion() != PieceType::NONE && bestMove.promotion() != PieceType::QUEEN)
+        return ConvertResult::SKIPPED;
+
+    board.getMoves(moves, false);
+    assert(moves.size() <= 218);
+
+    if (moves.size() == 0 || board.isFiftyMovesDraw() || board.isInsufficientMaterial())
+        return ConvertResult::SKIPPED;
+
+    u16 bestMove4096 = bestMove.to4096(board.sideToMove());
+
+    if (dedupTable != nullptr
+    && dedupTable->insert(dedupKey(board.zobristHash(), bestMove4096)) == DedupTable::Result::DUPLICATE)
+        return ConvertResult::DUPLICATE;
+
+    if (packed) {
+        PackedEntry entry = PackedEntry(board, bestMove4096);
+
+        if (labelValue)
+            entry.eval = std::clamp(value_nnue::evaluate(board), -32767, 32767);
+
+        const char *bytes = reinterpret_cast<const char*>(&entry);
+        outBuffer.insert(outBuffer.end(), bytes, bytes + sizeof(entry));
     }
+    else
+        DataEntry(board, moves, bestMove4096).write(outBuffer);
+
+    return ConvertResult::CONVERTED;
+}
+
+constexpr u64 CHUNK_BYTES = 16 * 1024 * 1024;
+
+struct Chunk {
+    u64 begin, end; // Byte offsets in the input file, line aligned
+    std::vector<char> output = {};
+    std::vector<CompressedBlock> blocks = {}; // Only if compressed, with offsets relative to output
+    u64 positionsSeen = 0, positionsConverted = 0, positionsDuplicate = 0;
+    bool converted = false;
 };
-#pragma pack(pop)
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cout << "Invalid number of args" << std::endl;
+    if (argc < 3 || argc > 8) {
+        std::cout << "Invalid number of args, expected <input file> <output file> [threads] [packed | compressed] [dedup[=MB]] [value=<value net file>]" << std::endl;
         return 1;
     }
 
-    // Parse and print file names
+    // Parse and print file names and options
     std::string inputFileName(argv[1]);
     std::string outputFileName(argv[2]);
-    std::cout << inputFileName << " to " << outputFileName << std::endl;
+    int numThreads = max((int)std::thread::hardware_concurrency(), 1);
+    bool packed = false; // Fixed size 32 bytes PackedEntry instead of DataEntry
+    bool compressed = false; // Block compressed DataEntry, see compressed_file.hpp
+    u64 dedupMB = 0; // Size of the table of seen positions, 0 = no deduplication
+    std::string valueNetFileName = ""; // Value net to label packed entries with, empty = no labels
+
+    for (int i = 3; i < argc; i++)
+        if (std::string(argv[i]) == "packed")
+            packed = true;
+        else if (std::string(argv[i]) == "compressed")
+            compressed = true;
+        else if (std::string(argv[i]) == "dedup")
+            dedupMB = 1024;
+        else if (std::string(argv[i]).starts_with("dedup="))
+            dedupMB = max(atoll(argv[i] + 6), 1LL);
+        else if (std::string(argv[i]).starts_with("value="))
+            valueNetFileName = argv[i] + 6;
+        else
+            numThreads = max(atoi(argv[i]), 1);
+
+    std::cout << inputFileName << " to " << outputFileName
+              << " with " << numThreads << " threads"
+              << (packed ? ", packed" : "")
+              << (compressed ? ", compressed" : "")
+              << (dedupMB > 0 ? ", dedup with " + std::to_string(dedupMB) + " MB" : "")
+              << (valueNetFileName != "" ? ", value labels from " + valueNetFileName : "") << std::endl;
+
+    if (packed && compressed) {
+        std::cout << "packed and compressed can't be used together" << std::endl;
+        return 1;
+    }
+
+    if (valueNetFileName != "" && !packed) {
+        std::cout << "Value labels require packed" << std::endl;
+        return 1;
+    }
+
+    if (valueNetFileName != "" && !value_nnue::loadNet(valueNetFileName)) {
+        std::cout << "Error loading value net" << std::endl;
+        return 1;
+    }
 
     // Open input file
-    std::ifstream inFile(inputFileName);
-    if (!inFile.is_open()) {
+    InputFile inFile = InputFile();
+    if (!inFile.open(inputFileName)) {
         std::cout << "Error opening input file" << std::endl;
         return 1;
     }
@@ -64,84 +139,147 @@ int main(int argc, char* argv[]) {
 
     initUtils();
     attacks::init();
+    initZobrist();
+
+    std::unique_ptr<DedupTable> dedupTable = dedupMB > 0 ? std::make_unique<DedupTable>(dedupMB) : nullptr;
 
-    // Iterate lines/positions in input file
-    u64 positionsSeen = 0, positionsConverted = 0;
-    std::string line;
-    while (std::getline(inFile, line))
+    // Split input file in line aligned chunks
+    std::vector<Chunk> chunks = {};
+    for (u64 begin = 0; begin < inFile.size(); )
     {
-        if (positionsSeen != 0 && (positionsSeen % 10'000'000) == 0)
-            std::cout << "Positions seen: " << positionsSeen << std::endl
-                      << "Positions converted: " << positionsConverted << std::endl;
+        u64 end = min(begin + CHUNK_BYTES, inFile.size());
+        const void *newline = memchr(inFile.data() + end - 1, '\n', inFile.size() - end + 1);
+        end = newline == nullptr ? inFile.size()
+              : (u64)(reinterpret_cast<const char*>(newline) - inFile.data()) + 1;
 
-        positionsSeen++;
-        std::vector<std::string> tokens = splitString(line, '|');
-        std::string fen = tokens[0];
-        std::string uciMove = tokens[1];
-        BoardState board = BoardState(fen);
-        Move bestMove = board.uciToMove(uciMove);
+        chunks.push_back({ begin, end });
+        begin = end;
+    }
 
-        if (bestMove.promotion() != PieceType::NONE && bestMove.promotion() != PieceType::QUEEN)
-            continue;
+    // Threads convert chunks in any order and the main thread writes them in order
+    // At most MAX_CHUNKS_IN_FLIGHT chunks are converted and not yet written, to bound memory usage
+    const u64 MAX_CHUNKS_IN_FLIGHT = numThreads * 2;
+    std::atomic<u64> nextChunkIdx = 0;
+    u64 chunksWritten = 0;
+    std::mutex mutex;
+    std::condition_variable chunkConverted, chunkWritten;
 
+    auto worker = [&]() {
         std::vector<Move> moves = {};
-        board.getMoves(moves, false);
-        assert(moves.size() <= 218);
+        u64 chunkIdx;
+
+        while ((chunkIdx = nextChunkIdx.fetch_add(1)) < chunks.size())
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                chunkWritten.wait(lock, [&]() { return chunkIdx < chunksWritten + MAX_CHUNKS_IN_FLIGHT; });
+            }
 
-        if (moves.size() == 0 || board.isFiftyMovesDraw() || board.isInsufficientMaterial()) 
-            continue;
+            Chunk &chunk = chunks[chunkIdx];
+            chunk.output.reserve((chunk.end - chunk.begin) * 2);
+            std::string_view text(inFile.data() + chunk.begin, chunk.end - chunk.begin);
 
-        DataEntry entry = DataEntry();
-        entry.stm = board.sideToMove();
-        assert(entry.stm != Color::NONE);
+            while (text.size() > 0)
+            {
+                size_t lineSize = min(text.find('\n'), text.size());
+                std::string_view line = text.substr(0, lineSize);
+                text.remove_prefix(min(lineSize + 1, text.size()));
 
-        u64 occ = board.occupancy();
-        entry.numActiveInputs = std::popcount(occ);
-        assert(entry.numActiveInputs >= 2 && entry.numActiveInputs <= 32);
+                if (line.find_first_not_of(" \t\r") == std::string_view::npos) continue;
 
-        while (occ > 0) {
-            Square sq = poplsb(occ);
-            Color color = board.colorAt(sq);
-            PieceType pt = board.pieceTypeAt(sq);
-            assert(color != Color::NONE && pt != PieceType::NONE);
+                ConvertResult result = convertLine(line, moves, chunk.output, packed, dedupTable.get(),
+                                                   valueNetFileName != "");
+                chunk.positionsSeen++;
+                chunk.positionsConverted += result == ConvertResult::CONVERTED;
+                chunk.positionsDuplicate += result == ConvertResult::DUPLICATE;
+            }
 
-            if (board.sideToMove() == Color::BLACK) {
-                color = oppColor(color);
-                sq ^= 56;
+            if (compressed) {
+                std::vector<char> compressedOutput = {};
+                compressedOutput.reserve(chunk.output.size());
+                compressEntries(std::string_view(chunk.output.data(), chunk.output.size()), compressedOutput, chunk.blocks);
+                chunk.output.swap(compressedOutput);
             }
 
-            entry.activeInputs.push_back((i16)color * 384 + (i16)pt * 64 + (i16)sq);
-            assert(entry.activeInputs.back() >= 0 && entry.activeInputs.back() < 768);
+            std::lock_guard<std::mutex> lock(mutex);
+            chunk.converted = true;
+            chunkConverted.notify_all();
         }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++)
+        threads.emplace_back(worker);
+
+    // Header is rewritten at the end, once the number of entries and blocks is known
+    CompressedHeader compressedHeader = CompressedHeader();
+    std::vector<CompressedBlock> compressedBlocks = {};
+    u64 outBytes = 0;
+
+    if (compressed) {
+        outFile.write(reinterpret_cast<const char*>(&compressedHeader), sizeof(compressedHeader));
+        outBytes += sizeof(compressedHeader);
+    }
+
+    // Write chunks in input order
+    u64 positionsSeen = 0, positionsConverted = 0, positionsDuplicate = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-        assert(entry.numActiveInputs == entry.activeInputs.size());
-        std::sort(entry.activeInputs.begin(), entry.activeInputs.end());
+    for (Chunk &chunk : chunks)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            chunkConverted.wait(lock, [&]() { return chunk.converted; });
+        }
 
-        entry.numMoves = moves.size();
-        for (Move move : moves) {
-            auto move4096 = move.to4096(board.sideToMove());
-            entry.moves4096.push_back((i16)move4096);
-            assert(entry.moves4096.back() >= 0 && entry.moves4096.back() < 4096);
+        for (CompressedBlock &block : chunk.blocks) {
+            block.offset += outBytes;
+            compressedBlocks.push_back(block);
         }
-        std::sort(entry.moves4096.begin(), entry.moves4096.end());
-
-        entry.bestMove4096 = bestMove.to4096(board.sideToMove());
-        assert(entry.bestMove4096 < 4096);
-
-        outFile.write(reinterpret_cast<const char*>(&entry.stm), sizeof(entry.stm));
-        outFile.write(reinterpret_cast<const char*>(&entry.numActiveInputs), sizeof(entry.numActiveInputs));
-        outFile.write(reinterpret_cast<const char*>(entry.activeInputs.data()), 2 * entry.activeInputs.size());
-        outFile.write(reinterpret_cast<const char*>(&entry.numMoves), sizeof(entry.numMoves));
-        outFile.write(reinterpret_cast<const char*>(entry.moves4096.data()), 2 * entry.moves4096.size());
-        outFile.write(reinterpret_cast<const char*>(&entry.bestMove4096), sizeof(entry.bestMove4096));
-        positionsConverted++;
+
+        outFile.write(chunk.output.data(), chunk.output.size());
+        outBytes += chunk.output.size();
+        std::vector<char>().swap(chunk.output); // Free memory
+        std::vector<CompressedBlock>().swap(chunk.blocks);
+
+        u64 prevPositionsSeen = positionsSeen;
+        positionsSeen += chunk.positionsSeen;
+        positionsConverted += chunk.positionsConverted;
+        positionsDuplicate += chunk.positionsDuplicate;
+
+        if (positionsSeen / 10'000'000 != prevPositionsSeen / 10'000'000)
+            std::cout << "Positions seen: " << positionsSeen << std::endl
+                      << "Positions converted: " << positionsConverted << std::endl
+                      << "Duplicate positions: " << positionsDuplicate << std::endl
+                      << "Positions/s: " << positionsSeen * 1000 / max(millisecondsElapsed(start), (u64)1) << std::endl;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        chunksWritten++;
+        chunkWritten.notify_all();
+    }
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    if (compressed) {
+        compressedHeader.numEntries = positionsConverted;
+        compressedHeader.numBlocks = compressedBlocks.size();
+        compressedHeader.indexOffset = outBytes;
+
+        outFile.write(reinterpret_cast<const char*>(compressedBlocks.data()), compressedBlocks.size() * sizeof(CompressedBlock));
+        outFile.seekp(0);
+        outFile.write(reinterpret_cast<const char*>(&compressedHeader), sizeof(compressedHeader));
     }
 
-    inFile.close();
     outFile.close();
     std::cout << "Conversion finished" << std::endl;
     std::cout << "Positions seen: " << positionsSeen << std::endl
-              << "Positions converted: " << positionsConverted << std::endl;
+              << "Positions converted: " << positionsConverted << std::endl
+              << "Duplicate positions: " << positionsDuplicate << std::endl
+              << "Positions/s: " << positionsSeen * 1000 / max(millisecondsElapsed(start), (u64)1) << std::endl;
+
+    if (dedupTable != nullptr)
+        std::cout << "Positions not checked for duplicates (dedup table full): " << dedupTable->unchecked() << std::endl;
 
     // Final output file size
     std::ifstream finalOutFile(outputFileName, std::ios::binary);
@@ -158,4 +296,4 @@ int main(int argc, char* argv[]) {
     std::cout << "Output megabytes: " << outSizeMB << std::endl;
 
     return 1;
-}
\ No newline at end of file
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// clang-format off
+#include <bit>
+#include "board.hpp"
+
+// Variable size training entry, as written by the converter
+#pragma pack(push, 1)
+struct DataEntry {
+    public:
+
+    Color stm = Color::NONE;
+    u8 numActiveInputs = 0;
+    std::array<i16, 32> activeInputs;
+    u8 numMoves = 0;
+    std::array<i16, 218> moves4096;
+    u16 bestMove4096 = 4096;
+
+    inline DataEntry() = default;
+
+    // moves are the legal moves of board without underpromotions
+    inline DataEntry(BoardState &board, std::vector<Move> &moves, u16 bestMove4096)
+    {
+        stm = board.sideToMove();
+        assert(stm != Color::NONE);
+
+        u64 occ = board.occupancy();
+        assert(std::popcount(occ) >= 2 && std::popcount(occ) <= 32);
+
+        while (occ > 0) {
+            Square sq = poplsb(occ);
+            Color color = board.colorAt(sq);
+            PieceType pt = board.pieceTypeAt(sq);
+            assert(color != Color::NONE && pt != PieceType::NONE);
+
+            if (board.sideToMove() == Color::BLACK) {
+                color = oppColor(color);
+                sq ^= 56;
+            }
+
+            activeInputs[numActiveInputs++] = (i16)color * 384 + (i16)pt * 64 + (i16)sq;
+            assert(activeInputs[numActiveInputs - 1] >= 0 && activeInputs[numActiveInputs - 1] < 768);
+        }
+
+        std::sort(activeInputs.begin(), activeInputs.begin() + numActiveInputs);
+
+        assert(moves.size() <= 218);
+        for (Move move : moves) {
+            moves4096[numMoves++] = (i16)move.to4096(board.sideToMove());
+            assert(moves4096[numMoves - 1] >= 0 && moves4096[numMoves - 1] < 4096);
+        }
+        std::sort(moves4096.begin(), moves4096.begin() + numMoves);
+
+        this->bestMove4096 = bestMove4096;
+        assert(bestMove4096 < 4096);
+    }
+
+    inline std::string toString()
+    {
+        return "stm " + std::to_string((int)stm)
+               + " numActiveInputs " + std::to_string((int)numActiveInputs)
+               + "\nactiveInputs " + vecToString(std::vector<i16>(activeInputs.begin(), activeInputs.begin() + numActiveInputs))
+               + "numMoves " +  std::to_string((int)numMoves)
+               + "\nmoves4096 " + vecToString(std::vector<i16>(moves4096.begin(), moves4096.begin() + numMoves))
+               + "bestmove4096 " + std::to_string(bestMove4096);
+    }
+
+    inline auto size()
+    {
+        return sizeof(stm)
+               + sizeof(numActiveInputs)
+               + 2 * numActiveInputs
+               + sizeof(numMoves)
+               + 2 * numMoves
+               + sizeof(bestMove4096);
+    }
+
+    // Appends the entry as it's stored in the output file
+    inline void write(std::vector<char> &buffer)
+    {
+        auto append = [&](const void *data, u64 numBytes) {
+            const char *bytes = reinterpret_cast<const char*>(data);
+            buffer.insert(buffer.end(), bytes, bytes + numBytes);
+        };
+
+        append(&stm, sizeof(stm));
+        append(&numActiveInputs, sizeof(numActiveInputs));
+        append(activeInputs.data(), 2 * numActiveInputs);
+        append(&numMoves, sizeof(numMoves));
+        append(moves4096.data(), 2 * numMoves);
+        append(&bestMove4096, sizeof(bestMove4096));
+    }
+};
+#pragma pack(pop)
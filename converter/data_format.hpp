@@ -0,0 +1,36 @@
+#pragma once
+
+// clang-format off
+#include "data_entry.hpp"
+#include "packed_entry.hpp"
+#include "compressed_file.hpp"
+
+// Formats of training data files
+enum class DataFormat : int {
+    DATA_ENTRY = 0,             // Converter output
+    DATA_ENTRY_WITH_VISITS = 1, // Engine datagen output, DataEntry followed by visits and result
+    PACKED = 2,                 // PackedEntry
+    PACKED_WITH_VISITS = 3,     // PackedEntryWithVisits, repacked from datagen output by repack.cpp
+    COMPRESSED = 4              // Block compressed DataEntry, see compressed_file.hpp
+};
+
+inline bool isFixedSize(DataFormat format) {
+    return format == DataFormat::PACKED || format == DataFormat::PACKED_WITH_VISITS;
+}
+
+// Size in bytes of the entry starting at data
+// Not for compressed files, whose entries are only reachable by decompressing their block
+inline u64 entrySize(const char *data, DataFormat format)
+{
+    assert(format != DataFormat::COMPRESSED);
+
+    if (format == DataFormat::PACKED) return sizeof(PackedEntry);
+    if (format == DataFormat::PACKED_WITH_VISITS) return sizeof(PackedEntryWithVisits);
+
+    const u8 *bytes = reinterpret_cast<const u8*>(data);
+    u64 numActiveInputs = bytes[1];
+    u64 numMoves = bytes[2 + 2 * numActiveInputs];
+    u64 size = 1 + 1 + 2 * numActiveInputs + 1 + 2 * numMoves + 2;
+
+    return format == DataFormat::DATA_ENTRY_WITH_VISITS ? size + 2 * numMoves + 1 : size;
+}
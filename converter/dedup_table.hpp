@@ -0,0 +1,61 @@
+#pragma once
+
+// clang-format off
+#include <atomic>
+#include <memory>
+#include <bit>
+#include <algorithm>
+#include "types.hpp"
+
+// Lock free set of 64 bit keys with a fixed memory size, shared by all converter threads
+// Open addressing with a bounded number of probes: once the probed slots of a key are all taken,
+// the key is treated as new and counted as unchecked, so memory never grows
+class DedupTable {
+    private:
+
+    static constexpr u64 MAX_PROBES = 32;
+
+    std::unique_ptr<std::atomic<u64>[]> mSlots; // 0 = empty
+    u64 mMask;
+    std::atomic<u64> mUnchecked = 0;
+
+    public:
+
+    enum class Result { NEW, DUPLICATE, UNCHECKED };
+
+    inline DedupTable(u64 megabytes)
+    {
+        u64 numSlots = std::bit_floor(std::max(megabytes * 1024 * 1024 / sizeof(u64), (u64)1));
+        mSlots = std::make_unique<std::atomic<u64>[]>(numSlots);
+        mMask = numSlots - 1;
+    }
+
+    inline u64 numSlots() { return mMask + 1; }
+
+    inline u64 unchecked() { return mUnchecked.load(std::memory_order_relaxed); }
+
+    inline Result insert(u64 key)
+    {
+        if (key == 0) key = 1;
+
+        for (u64 i = 0; i < MAX_PROBES; i++)
+        {
+            std::atomic<u64> &slot = mSlots[(key + i) & mMask];
+            u64 slotKey = slot.load(std::memory_order_relaxed);
+
+            if (slotKey == 0 && slot.compare_exchange_strong(slotKey, key, std::memory_order_relaxed))
+                return Result::NEW;
+
+            // slotKey is the current key after a failed compare_exchange
+            if (slotKey == key) return Result::DUPLICATE;
+        }
+
+        mUnchecked.fetch_add(1, std::memory_order_relaxed);
+        return Result::UNCHECKED;
+    }
+};
+
+// Dedup key of a position and its best move
+inline u64 dedupKey(u64 zobristHash, u16 bestMove4096) {
+    return zobristHash ^ ((u64)(bestMove4096 + 1) * 0x9E3779B97F4A7C15ULL);
+}
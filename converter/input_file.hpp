@@ -0,0 +1,93 @@
+#pragma once
+
+// clang-format off
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include "types.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #define CONVERTER_MMAP
+#endif
+
+// Read only view of the whole input file, memory mapped when possible
+class InputFile {
+    private:
+
+    const char *mData = nullptr;
+    u64 mSize = 0;
+    std::vector<char> mBuffer = {}; // Used if the file can't be memory mapped
+
+    public:
+
+    inline InputFile() = default;
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    inline bool open(std::string fileName)
+    {
+        #if defined(CONVERTER_MMAP)
+            int fd = ::open(fileName.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+
+            struct stat fileStat;
+            if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+            {
+                mSize = fileStat.st_size;
+                void *mapped = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+                close(fd);
+
+                if (mapped != MAP_FAILED) {
+                    madvise(mapped, mSize, MADV_SEQUENTIAL);
+                    mData = reinterpret_cast<const char*>(mapped);
+                    return true;
+                }
+            }
+            else
+                close(fd);
+        #endif
+
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file.is_open()) return false;
+
+        mBuffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        mData = mBuffer.data();
+        mSize = mBuffer.size();
+        return true;
+    }
+
+    inline ~InputFile()
+    {
+        #if defined(CONVERTER_MMAP)
+            if (mBuffer.size() == 0 && mData != nullptr)
+                munmap(const_cast<char*>(mData), mSize);
+        #endif
+    }
+
+    // Lets the OS drop the pages of an already read range, so reading a huge file once
+    // doesn't fill memory with its pages
+    inline void dontNeed(u64 offset, u64 size)
+    {
+        #if defined(CONVERTER_MMAP)
+            if (mBuffer.size() > 0 || mData == nullptr) return;
+
+            const u64 pageSize = sysconf(_SC_PAGESIZE);
+            u64 begin = (offset + pageSize - 1) / pageSize * pageSize;
+            u64 end = std::min(offset + size, mSize) / pageSize * pageSize;
+
+            if (end > begin)
+                madvise(const_cast<char*>(mData) + begin, end - begin, MADV_DONTNEED);
+        #endif
+    }
+
+    inline const char* data() { return mData; }
+
+    inline u64 size() { return mSize; }
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+// clang-format off
+#include "data_entry.hpp"
+
+// Fixed size training entry, 32 bytes, or 48 bytes with visit targets
+// The board is stored as is (not from stm perspective) with castling rights and en passant square,
+// so legal moves and active inputs are regenerated when decoding instead of being stored
+#pragma pack(push, 1)
+struct PackedEntry {
+    public:
+
+    u64 occupancy = 0;
+    std::array<u8, 16> pieces = {}; // 4 bits per piece (color * 6 + pieceType) in occupancy lsb order, low nibble first
+    u8 stmAndCastling = 0; // Bit 0 = stm, bits 1-4 = white short, white long, black short, black long castling rights
+    Square enPassantSquare = SQUARE_NONE;
+    u8 pliesSincePawnOrCapture = 0;
+    i8 result = 0; // From stm perspective, 1 = win, 0 = draw or unknown, -1 = loss
+    u16 bestMove4096 = 4096; // From stm perspective, like in DataEntry
+    i16 eval = 0; // Value net eval in centipawns from stm perspective, 0 if not labelled
+
+    inline PackedEntry() = default;
+
+    inline PackedEntry(BoardState &board, u16 bestMove4096, i8 result = 0)
+    {
+        occupancy = board.occupancy();
+        int pieceIdx = 0;
+
+        for (u64 occ = occupancy; occ > 0; pieceIdx++)
+        {
+            Square sq = poplsb(occ);
+            u8 pieceCode = (u8)board.colorAt(sq) * 6 + (u8)board.pieceTypeAt(sq);
+            pieces[pieceIdx / 2] |= pieceCode << (4 * (pieceIdx % 2));
+        }
+
+        stmAndCastling = (u8)board.sideToMove();
+        int bit = 1;
+        for (Color color : {Color::WHITE, Color::BLACK})
+            for (int castlingRight : {CASTLE_SHORT, CASTLE_LONG})
+                stmAndCastling |= (board.castlingRights() & CASTLING_MASKS[(int)color][castlingRight] ? 1 : 0) << bit++;
+
+        enPassantSquare = board.enPassantSquare();
+        pliesSincePawnOrCapture = board.pliesSincePawnOrCapture();
+        this->result = result;
+        this->bestMove4096 = bestMove4096;
+    }
+
+    inline BoardState unpack() const
+    {
+        std::array<u64, 2> colorBitboards = {};
+        std::array<u64, 6> piecesBitboards = {};
+        int pieceIdx = 0;
+
+        for (u64 occ = occupancy; occ > 0; pieceIdx++)
+        {
+            Square sq = poplsb(occ);
+            u8 pieceCode = (pieces[pieceIdx / 2] >> (4 * (pieceIdx % 2))) & 0xF;
+            assert(pieceCode < 12);
+            colorBitboards[pieceCode / 6] |= 1ULL << sq;
+            piecesBitboards[pieceCode % 6] |= 1ULL << sq;
+        }
+
+        u64 castlingRights = 0;
+        int bit = 1;
+        for (Color color : {Color::WHITE, Color::BLACK})
+            for (int castlingRight : {CASTLE_SHORT, CASTLE_LONG})
+                if (stmAndCastling & (1 << bit++))
+                    castlingRights |= CASTLING_MASKS[(int)color][castlingRight];
+
+        return BoardState((Color)(stmAndCastling & 1), colorBitboards, piecesBitboards,
+                          castlingRights, enPassantSquare, pliesSincePawnOrCapture);
+    }
+
+    // Regenerates the active inputs and legal moves
+    inline DataEntry decode(std::vector<Move> &moves) const
+    {
+        BoardState board = unpack();
+        board.getMoves(moves, false);
+        return DataEntry(board, moves, bestMove4096);
+    }
+};
+
+// Visit targets of the most visited moves, appended to a PackedEntry
+constexpr int PACKED_VISIT_TARGETS = 4;
+
+struct PackedVisits {
+    public:
+
+    std::array<u16, PACKED_VISIT_TARGETS> moves4096; // 4096 if unused
+    std::array<u16, PACKED_VISIT_TARGETS> visits; // Scaled so the most visited move has 65535
+
+    inline PackedVisits() {
+        moves4096.fill(4096);
+        visits.fill(0);
+    }
+
+    // moves4096AndVisits are (move4096, visits) pairs from stm perspective
+    inline PackedVisits(std::vector<std::pair<u16, u32>> moves4096AndVisits) : PackedVisits()
+    {
+        std::stable_sort(moves4096AndVisits.begin(), moves4096AndVisits.end(), [](auto &a, auto &b) {
+            return a.second > b.second;
+        });
+
+        if (moves4096AndVisits.size() == 0 || moves4096AndVisits[0].second == 0) return;
+        u64 maxVisits = moves4096AndVisits[0].second;
+
+        for (int i = 0; i < min((int)moves4096AndVisits.size(), PACKED_VISIT_TARGETS); i++) {
+            moves4096[i] = moves4096AndVisits[i].first;
+            visits[i] = (u64)moves4096AndVisits[i].second * 65535 / maxVisits;
+        }
+    }
+};
+
+struct PackedEntryWithVisits {
+    public:
+
+    PackedEntry entry;
+    PackedVisits visits;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PackedEntry) == 32);
+static_assert(sizeof(PackedEntryWithVisits) == 48);
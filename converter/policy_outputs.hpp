@@ -0,0 +1,32 @@
+#pragma once
+
+// clang-format off
+#include <array>
+#include <algorithm>
+#include "types.hpp"
+
+// Output layers of the policy net, see policy.hpp in the engine
+// The compact one has 1 output per from-to pair that a queen or a knight can make on an empty board
+constexpr int OUTPUT_SIZE_4096 = 4096, OUTPUT_SIZE_COMPACT = 1792;
+
+// [move4096] -> compact output index, -1 if no piece can make the move
+// Same as policy::OUTPUT_IDXS in the engine built with -DPOLICY_COMPACT
+constexpr std::array<i16, 4096> COMPACT_OUTPUT_IDXS = []() {
+    std::array<i16, 4096> outputIdxs = {};
+    i16 numOutputs = 0;
+
+    for (int from = 0; from < 64; from++)
+        for (int to = 0; to < 64; to++) {
+            int fileDiff = std::max(from % 8, to % 8) - std::min(from % 8, to % 8);
+            int rankDiff = std::max(from / 8, to / 8) - std::min(from / 8, to / 8);
+
+            bool isQueenOrKnightMove = from != to
+                                       && (fileDiff == 0 || rankDiff == 0 || fileDiff == rankDiff || fileDiff * rankDiff == 2);
+
+            outputIdxs[from * 64 + to] = isQueenOrKnightMove ? numOutputs++ : -1;
+        }
+
+    return outputIdxs;
+}();
+
+static_assert(COMPACT_OUTPUT_IDXS[63 * 64 + 62] == OUTPUT_SIZE_COMPACT - 1);
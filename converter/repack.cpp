@@ -0,0 +1,180 @@
+// clang-format off
+
+// Repacks engine datagen files (format 1) into fixed size packed entries with visits (format 3)
+// Build from the converter folder with
+// clang++ -std=c++20 -O3 -march=native repack.cpp -o repack
+//
+// Datagen entries don't store the board, so it's rebuilt from the active inputs, with the castling rights
+// and en passant square of the castling and en passant moves found in the legal moves
+// The 50 moves counter is lost and other castling rights don't change the legal moves, so the rebuilt board
+// decodes to the same entry, which is checked for each entry
+// Only the PACKED_VISIT_TARGETS most visited moves are kept as visit targets
+
+#include <fstream>
+#include "data_format.hpp"
+#include "input_file.hpp"
+
+// Castling moves4096 from stm perspective, e1g1 and e1c1
+constexpr u16 SHORT_CASTLE_4096 = 4 * 64 + 6, LONG_CASTLE_4096 = 4 * 64 + 2;
+
+// Returns false if the rebuilt board doesn't decode to the same entry
+inline bool repackEntry(DataEntry &entry, std::array<u16, 218> &visits, i8 result,
+                        PackedEntryWithVisits &packed, std::vector<Move> &moves)
+{
+    Color stm = entry.stm;
+    std::array<u64, 2> colorBitboards = {};
+    std::array<u64, 6> piecesBitboards = {};
+
+    for (int i = 0; i < entry.numActiveInputs; i++)
+    {
+        int input = entry.activeInputs[i];
+        Color color = (Color)(input / 384);
+        Square sq = input % 64;
+
+        if (stm == Color::BLACK) {
+            color = oppColor(color);
+            sq ^= 56;
+        }
+
+        colorBitboards[(int)color] |= 1ULL << sq;
+        piecesBitboards[input / 64 % 6] |= 1ULL << sq;
+    }
+
+    u64 castlingRights = 0;
+    Square enPassantSquare = SQUARE_NONE;
+    u64 occupancy = colorBitboards[0] | colorBitboards[1];
+    u64 ourPawns = colorBitboards[(int)stm] & piecesBitboards[(int)PieceType::PAWN];
+
+    for (int i = 0; i < entry.numMoves; i++)
+    {
+        u16 move4096 = entry.moves4096[i];
+        Square from = move4096 / 64, to = move4096 % 64;
+
+        if (stm == Color::BLACK) {
+            from ^= 56;
+            to ^= 56;
+        }
+
+        if (move4096 == SHORT_CASTLE_4096 || move4096 == LONG_CASTLE_4096)
+        {
+            u64 kingBb = colorBitboards[(int)stm] & piecesBitboards[(int)PieceType::KING];
+            if (kingBb & (1ULL << from))
+                castlingRights |= CASTLING_MASKS[(int)stm][move4096 == SHORT_CASTLE_4096 ? CASTLE_SHORT : CASTLE_LONG];
+        }
+
+        // Diagonal pawn move to an empty square
+        if ((ourPawns & (1ULL << from)) && from % 8 != to % 8 && !(occupancy & (1ULL << to)))
+            enPassantSquare = to;
+    }
+
+    BoardState board = BoardState(stm, colorBitboards, piecesBitboards, castlingRights, enPassantSquare, 0);
+
+    std::vector<std::pair<u16, u32>> moves4096AndVisits = {};
+    for (int i = 0; i < entry.numMoves; i++)
+        moves4096AndVisits.push_back({ (u16)entry.moves4096[i], visits[i] });
+
+    packed.entry = PackedEntry(board, entry.bestMove4096, result);
+    packed.visits = PackedVisits(moves4096AndVisits);
+
+    DataEntry decoded = packed.entry.decode(moves);
+
+    return decoded.stm == entry.stm
+           && decoded.numActiveInputs == entry.numActiveInputs
+           && std::equal(entry.activeInputs.begin(), entry.activeInputs.begin() + entry.numActiveInputs,
+                         decoded.activeInputs.begin())
+           && decoded.numMoves == entry.numMoves
+           && std::equal(entry.moves4096.begin(), entry.moves4096.begin() + entry.numMoves,
+                         decoded.moves4096.begin());
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cout << "Invalid number of args, expected <datagen input file> <output file>" << std::endl;
+        return 1;
+    }
+
+    std::string inputFileName(argv[1]);
+    std::string outputFileName(argv[2]);
+    std::cout << "Repacking " << inputFileName << " to " << outputFileName << std::endl;
+
+    InputFile inFile = InputFile();
+    if (!inFile.open(inputFileName)) {
+        std::cout << "Error opening input file" << std::endl;
+        return 1;
+    }
+
+    std::ofstream outFile(outputFileName, std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) {
+        std::cout << "Error opening output file" << std::endl;
+        return 1;
+    }
+
+    initUtils();
+    attacks::init();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<Move> moves = {};
+    std::vector<char> outBuffer = {};
+    u64 entriesRepacked = 0, entriesSkipped = 0, offset = 0;
+
+    while (offset < inFile.size())
+    {
+        u64 size = entrySize(inFile.data() + offset, DataFormat::DATA_ENTRY_WITH_VISITS);
+
+        if (offset + size > inFile.size()) {
+            std::cout << "Ignoring truncated entry at the end of " << inputFileName << std::endl;
+            break;
+        }
+
+        const char *data = inFile.data() + offset;
+        offset += size;
+
+        auto read = [&](void *dst, u64 numBytes) {
+            memcpy(dst, data, numBytes);
+            data += numBytes;
+        };
+
+        DataEntry entry = DataEntry();
+        std::array<u16, 218> visits;
+        i8 result;
+
+        read(&entry.stm, 1);
+        read(&entry.numActiveInputs, 1);
+        read(entry.activeInputs.data(), 2 * entry.numActiveInputs);
+        read(&entry.numMoves, 1);
+        read(entry.moves4096.data(), 2 * entry.numMoves);
+        read(&entry.bestMove4096, 2);
+        read(visits.data(), 2 * entry.numMoves);
+        read(&result, 1);
+
+        PackedEntryWithVisits packed;
+        if (!repackEntry(entry, visits, result, packed, moves)) {
+            entriesSkipped++;
+            continue;
+        }
+
+        const char *bytes = reinterpret_cast<const char*>(&packed);
+        outBuffer.insert(outBuffer.end(), bytes, bytes + sizeof(packed));
+        entriesRepacked++;
+
+        if (outBuffer.size() >= 16 * 1024 * 1024) {
+            outFile.write(outBuffer.data(), outBuffer.size());
+            outBuffer.clear();
+        }
+    }
+
+    outFile.write(outBuffer.data(), outBuffer.size());
+    outFile.close();
+
+    if (outFile.fail()) {
+        std::cout << "Error writing output file" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Repack finished" << std::endl
+              << "Entries repacked: " << entriesRepacked << std::endl
+              << "Entries skipped: " << entriesSkipped << std::endl
+              << "Entries/s: " << (entriesRepacked + entriesSkipped) * 1000 / max(millisecondsElapsed(start), (u64)1) << std::endl;
+
+    return 0;
+}
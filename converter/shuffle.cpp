@@ -0,0 +1,358 @@
+// clang-format off
+
+// External memory shuffler for training data files, using bounded memory regardless of data size
+// Build from the converter folder with
+// clang++ -std=c++20 -O3 -march=native shuffle.cpp -o shuffle
+//
+// 1. Input files are read in order in chunks of at most <memory MB>, each chunk is shuffled in memory
+//    and written to a temporary run file next to the output file
+// 2. Runs are merged by repeatedly taking the next entry of a random run, picked with probability
+//    proportional to its remaining entries, which results in a uniformly random permutation of all entries
+// Multiple input files are interleaved, since the merge doesn't care which input an entry came from
+// Compressed files are decompressed into the runs and compressed again in the output
+// The memory limit covers the chunk's entries and their offsets
+// The seed is random unless given with seed=<seed>, and is printed so a shuffle can be reproduced
+
+#include <fstream>
+#include <random>
+#include <filesystem>
+#include "data_format.hpp"
+#include "input_file.hpp"
+
+constexpr u64 WRITE_BUFFER_BYTES = 16 * 1024 * 1024;
+
+// Smallest variable size entry: stm, 2 kings, 1 legal move and the best move
+constexpr u64 MIN_VARIABLE_ENTRY_BYTES = 1 + 1 + 2 * 2 + 1 + 2 * 1 + 2;
+
+// Buffered output file
+class OutputFile {
+    private:
+
+    std::ofstream mFile;
+    std::vector<char> mBuffer = {};
+
+    public:
+
+    inline bool open(std::string fileName)
+    {
+        mFile.open(fileName, std::ios::binary | std::ios::trunc);
+        mBuffer.reserve(WRITE_BUFFER_BYTES);
+        return mFile.is_open();
+    }
+
+    inline void write(const char *data, u64 numBytes)
+    {
+        if (mBuffer.size() + numBytes > WRITE_BUFFER_BYTES) flush();
+        mBuffer.insert(mBuffer.end(), data, data + numBytes);
+    }
+
+    inline void flush()
+    {
+        mFile.write(mBuffer.data(), mBuffer.size());
+        mBuffer.clear();
+    }
+
+    inline bool close()
+    {
+        flush();
+        mFile.close();
+        return !mFile.fail();
+    }
+};
+
+// Fenwick tree of remaining entries per run, to pick a run in O(log(runs))
+class RunPicker {
+    private:
+
+    std::vector<u64> mTree; // 1-indexed
+
+    public:
+
+    inline RunPicker(const std::vector<u64> &runsEntries) : mTree(runsEntries.size() + 1, 0)
+    {
+        for (u64 i = 0; i < runsEntries.size(); i++)
+            add(i, runsEntries[i]);
+    }
+
+    inline void add(u64 runIdx, i64 delta)
+    {
+        for (u64 i = runIdx + 1; i < mTree.size(); i += i & (~i + 1))
+            mTree[i] += delta;
+    }
+
+    // Returns the run containing the entry at index target of all remaining entries
+    inline u64 pick(u64 target)
+    {
+        u64 pos = 0;
+
+        for (u64 step = std::bit_floor(mTree.size() - 1); step > 0; step /= 2)
+            if (pos + step < mTree.size() && mTree[pos + step] <= target) {
+                pos += step;
+                target -= mTree[pos];
+            }
+
+        return pos;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        std::cout << "Invalid number of args, expected <format> <memory MB> <output file> [seed=<seed>] <input files...>" << std::endl;
+        std::cout << "Formats: 0 = converter, 1 = converter with visits (datagen), 2 = packed, 3 = packed with visits, 4 = compressed" << std::endl;
+        return 1;
+    }
+
+    // Parse and print args
+    int formatInt = atoi(argv[1]);
+    if (formatInt < 0 || formatInt > 4) {
+        std::cout << "Invalid format " << argv[1] << std::endl;
+        return 1;
+    }
+
+    DataFormat format = (DataFormat)formatInt;
+    bool compressed = format == DataFormat::COMPRESSED;
+    DataFormat runFormat = compressed ? DataFormat::DATA_ENTRY : format;
+    u64 memoryBytes = max((u64)atoll(argv[2]), (u64)1) * 1024 * 1024;
+    std::string outputFileName(argv[3]);
+    std::vector<std::string> inputFileNames = {};
+    u64 seed = std::random_device()();
+
+    for (int i = 4; i < argc; i++)
+        if (std::string(argv[i]).starts_with("seed="))
+            seed = strtoull(argv[i] + 5, nullptr, 10);
+        else
+            inputFileNames.push_back(argv[i]);
+
+    if (inputFileNames.size() == 0) {
+        std::cout << "No input files" << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+
+    std::cout << "Shuffling " << inputFileNames.size() << " files to " << outputFileName
+              << " with format " << formatInt
+              << ", " << memoryBytes / (1024 * 1024) << " MB of memory"
+              << ", seed " << seed << std::endl;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Phase 1: write shuffled runs
+    std::vector<std::string> runsFileNames = {};
+    std::vector<u64> runsEntries = {};
+    u64 totalEntries = 0;
+
+    // Reserved so neither grows past the memory limit by reallocating, only the used part is resident
+    std::vector<char> chunk = {};
+    std::vector<u64> entriesOffsets = {};
+    u64 minEntryBytes = isFixedSize(runFormat) ? entrySize(nullptr, runFormat) : MIN_VARIABLE_ENTRY_BYTES;
+    chunk.reserve(memoryBytes);
+    entriesOffsets.reserve(memoryBytes / (minEntryBytes + sizeof(u64)) + 1);
+
+    auto writeRun = [&]() {
+        if (entriesOffsets.size() == 0) return true;
+
+        std::shuffle(entriesOffsets.begin(), entriesOffsets.end(), rng);
+
+        runsFileNames.push_back(outputFileName + ".run" + std::to_string(runsFileNames.size()));
+        OutputFile runFile = OutputFile();
+
+        if (!runFile.open(runsFileNames.back())) {
+            std::cout << "Error opening run file " << runsFileNames.back() << std::endl;
+            return false;
+        }
+
+        for (u64 offset : entriesOffsets)
+            runFile.write(chunk.data() + offset, entrySize(chunk.data() + offset, runFormat));
+
+        if (!runFile.close()) {
+            std::cout << "Error writing run file " << runsFileNames.back() << std::endl;
+            return false;
+        }
+
+        runsEntries.push_back(entriesOffsets.size());
+        totalEntries += entriesOffsets.size();
+
+        std::cout << "Run " << runsFileNames.size() << ": " << entriesOffsets.size() << " entries"
+                  << ", total " << totalEntries << " entries"
+                  << ", " << millisecondsElapsed(start) / 1000 << "s" << std::endl;
+
+        chunk.clear();
+        entriesOffsets.clear();
+        return true;
+    };
+
+    // readBytes are the bytes of the input file already read, which can be dropped from memory
+    auto addEntry = [&](InputFile &inFile, const char *entry, u64 size, u64 readBytes) {
+        if (chunk.size() + size + (entriesOffsets.size() + 1) * sizeof(u64) > memoryBytes)
+        {
+            if (!writeRun()) return false;
+            inFile.dontNeed(0, readBytes);
+        }
+
+        entriesOffsets.push_back(chunk.size());
+        chunk.insert(chunk.end(), entry, entry + size);
+        return true;
+    };
+
+    std::vector<char> decompressed = {};
+
+    for (std::string &inputFileName : inputFileNames)
+    {
+        InputFile inFile = InputFile();
+        if (!inFile.open(inputFileName)) {
+            std::cout << "Error opening input file " << inputFileName << std::endl;
+            return 1;
+        }
+
+        if (compressed)
+        {
+            CompressedHeader header;
+            std::vector<CompressedBlock> blocks = {};
+
+            if (!readCompressedIndex(inFile.data(), inFile.size(), header, blocks)) {
+                std::cout << "Invalid compressed file " << inputFileName << std::endl;
+                return 1;
+            }
+
+            DataEntry entry = DataEntry();
+
+            for (CompressedBlock &block : blocks)
+            {
+                const u8 *data = reinterpret_cast<const u8*>(inFile.data() + block.offset);
+
+                for (u32 i = 0; i < block.numEntries; i++)
+                {
+                    decompressEntry(data, entry);
+                    decompressed.clear();
+                    entry.write(decompressed);
+
+                    if (!addEntry(inFile, decompressed.data(), decompressed.size(), block.offset)) return 1;
+                }
+            }
+
+            continue;
+        }
+
+        u64 offset = 0;
+        while (offset < inFile.size())
+        {
+            u64 size = entrySize(inFile.data() + offset, format);
+
+            if (offset + size > inFile.size()) {
+                std::cout << "Ignoring truncated entry at the end of " << inputFileName << std::endl;
+                break;
+            }
+
+            if (!addEntry(inFile, inFile.data() + offset, size, offset)) return 1;
+            offset += size;
+        }
+    }
+
+    if (!writeRun()) return 1;
+    std::vector<char>().swap(chunk); // Free memory
+    std::vector<u64>().swap(entriesOffsets);
+
+    // Phase 2: merge runs
+    OutputFile outFile = OutputFile();
+    if (!outFile.open(outputFileName)) {
+        std::cout << "Error opening output file" << std::endl;
+        return 1;
+    }
+
+    std::vector<InputFile> runs(runsFileNames.size());
+    std::vector<u64> runsOffsets(runs.size(), 0);
+
+    for (u64 i = 0; i < runs.size(); i++)
+        if (!runs[i].open(runsFileNames[i])) {
+            std::cout << "Error opening run file " << runsFileNames[i] << std::endl;
+            return 1;
+        }
+
+    // Compressed output is written block by block, then the blocks index and the final header
+    CompressedHeader compressedHeader = CompressedHeader();
+    std::vector<CompressedBlock> compressedBlocks = {};
+    std::vector<char> blockEntries = {}, compressedBlock = {};
+    u64 blockNumEntries = 0, outBytes = 0;
+
+    auto writeCompressedBlock = [&]() {
+        if (blockNumEntries == 0) return;
+
+        compressedBlock.clear();
+        std::vector<CompressedBlock> blocks = {};
+        compressEntries(std::string_view(blockEntries.data(), blockEntries.size()), compressedBlock, blocks);
+        assert(blocks.size() == 1);
+
+        blocks[0].offset = outBytes;
+        compressedBlocks.push_back(blocks[0]);
+        outFile.write(compressedBlock.data(), compressedBlock.size());
+        outBytes += compressedBlock.size();
+
+        blockEntries.clear();
+        blockNumEntries = 0;
+    };
+
+    if (compressed) {
+        outFile.write(reinterpret_cast<const char*>(&compressedHeader), sizeof(compressedHeader));
+        outBytes += sizeof(compressedHeader);
+    }
+
+    RunPicker runPicker = RunPicker(runsEntries);
+
+    for (u64 remaining = totalEntries; remaining > 0; remaining--)
+    {
+        u64 runIdx = runPicker.pick(std::uniform_int_distribution<u64>(0, remaining - 1)(rng));
+        runPicker.add(runIdx, -1);
+
+        InputFile &run = runs[runIdx];
+        const char *entry = run.data() + runsOffsets[runIdx];
+        u64 size = entrySize(entry, runFormat);
+
+        if (compressed) {
+            blockEntries.insert(blockEntries.end(), entry, entry + size);
+            if (++blockNumEntries == COMPRESSED_BLOCK_ENTRIES) writeCompressedBlock();
+        }
+        else
+            outFile.write(entry, size);
+
+        // Drop merged pages every 64 MB of each run
+        if ((runsOffsets[runIdx] + size) / (64 * 1024 * 1024) != runsOffsets[runIdx] / (64 * 1024 * 1024))
+            run.dontNeed(0, runsOffsets[runIdx]);
+
+        runsOffsets[runIdx] += size;
+
+        if ((totalEntries - remaining + 1) % 100'000'000 == 0)
+            std::cout << "Entries merged: " << totalEntries - remaining + 1
+                      << ", " << millisecondsElapsed(start) / 1000 << "s" << std::endl;
+    }
+
+    if (compressed) {
+        writeCompressedBlock();
+        outFile.write(reinterpret_cast<const char*>(compressedBlocks.data()), compressedBlocks.size() * sizeof(CompressedBlock));
+    }
+
+    if (!outFile.close()) {
+        std::cout << "Error writing output file" << std::endl;
+        return 1;
+    }
+
+    if (compressed) {
+        compressedHeader.numEntries = totalEntries;
+        compressedHeader.numBlocks = compressedBlocks.size();
+        compressedHeader.indexOffset = outBytes;
+
+        std::fstream headerFile(outputFileName, std::ios::binary | std::ios::in | std::ios::out);
+        headerFile.write(reinterpret_cast<const char*>(&compressedHeader), sizeof(compressedHeader));
+    }
+
+    runs.clear();
+    for (std::string &runFileName : runsFileNames)
+        std::filesystem::remove(runFileName);
+
+    std::cout << "Shuffle finished" << std::endl
+              << "Entries: " << totalEntries << std::endl
+              << "Runs: " << runsFileNames.size() << std::endl
+              << "Entries/s: " << totalEntries * 1000 / max(millisecondsElapsed(start), (u64)1) << std::endl;
+
+    return 0;
+}
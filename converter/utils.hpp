@@ -2,6 +2,7 @@
 
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <array>
 #include <iostream>
@@ -84,7 +85,7 @@ const std::string SQUARE_TO_STR[64] = {
     "a8", "b8", "c8", "d8", "e8", "f8", "g8", "h8",
 };
 
-inline Square strToSquare(std::string strSquare) {
+inline Square strToSquare(std::string_view strSquare) {
     return (strSquare[0] - 'a') + (strSquare[1] - '1') * 8;
 }
 
@@ -118,6 +119,20 @@ std::unordered_map<char, PieceType> CHAR_TO_PIECE_TYPE = {
     {'k', PieceType::KING},
 };
 
+// Same as CHAR_TO_PIECE_TYPE, without a map lookup
+constexpr PieceType charToPieceType(char pieceChar)
+{
+    switch (pieceChar) {
+        case 'P': case 'p': return PieceType::PAWN;
+        case 'N': case 'n': return PieceType::KNIGHT;
+        case 'B': case 'b': return PieceType::BISHOP;
+        case 'R': case 'r': return PieceType::ROOK;
+        case 'Q': case 'q': return PieceType::QUEEN;
+        case 'K': case 'k': return PieceType::KING;
+        default: return PieceType::NONE;
+    }
+}
+
 std::unordered_map<Piece, char> PIECE_TO_CHAR = {
     {Piece::WHITE_PAWN,   'P'},
     {Piece::WHITE_KNIGHT, 'N'},
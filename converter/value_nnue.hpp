@@ -0,0 +1,125 @@
+// clang-format off
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include "board.hpp"
+#include "simd.hpp"
+using namespace SIMD;
+
+// Copy of the engine's value net evaluation, with the net loaded from a file at runtime
+// instead of embedded, so positions are labelled with whichever net is given
+namespace value_nnue {
+
+const u16 HIDDEN_LAYER_SIZE = 128;
+const i32 SCALE = 400, QA = 181, QB = 64;
+constexpr int WEIGHTS_PER_VEC = sizeof(Vec) / sizeof(i16);
+
+struct alignas(ALIGNMENT) Net {
+    std::array<i16, 768 * HIDDEN_LAYER_SIZE>          featureWeights;
+    std::array<i16, HIDDEN_LAYER_SIZE>                featureBiases;
+    std::array<std::array<i16, HIDDEN_LAYER_SIZE>, 2> outputWeights;
+    i16                                               outputBias;
+};
+
+std::unique_ptr<Net> NET;
+
+// The file may be padded after the net, like src/value_net.nnue
+inline bool loadNet(std::string fileName)
+{
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open() || (u64)file.tellg() < offsetof(Net, outputBias) + sizeof(i16)) 
+        return false;
+
+    NET = std::make_unique<Net>();
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(NET.get()), offsetof(Net, outputBias) + sizeof(i16));
+    return !file.fail();
+}
+
+struct alignas(ALIGNMENT) Accumulator
+{
+    std::array<i16, HIDDEN_LAYER_SIZE> white, black;
+
+    // Converter boards are parsed once and never make moves, so the accumulator is built from scratch
+    inline Accumulator(BoardState &board) 
+    {
+        for (int i = 0; i < HIDDEN_LAYER_SIZE; i++)
+            white[i] = black[i] = NET->featureBiases[i];
+
+        for (u64 occ = board.occupancy(); occ > 0; )
+        {
+            Square sq = poplsb(occ);
+            activate(board.colorAt(sq), board.pieceTypeAt(sq), sq);
+        }
+    }
+
+    inline void activate(Color color, PieceType pieceType, Square sq)
+    {
+        int whiteIdx = (int)color * 384 + (int)pieceType * 64 + sq;
+        int blackIdx = !(int)color * 384 + (int)pieceType * 64 + (sq ^ 56);
+
+        for (int i = 0; i < HIDDEN_LAYER_SIZE; i++) {
+            white[i] += NET->featureWeights[whiteIdx * HIDDEN_LAYER_SIZE + i];
+            black[i] += NET->featureWeights[blackIdx * HIDDEN_LAYER_SIZE + i];
+        }
+    }
+}; // struct alignas(ALIGNMENT) Accumulator
+
+// First size neurons of the side to move's accumulator, from side to move relative inputs
+// (DataEntry activeInputs, which are the value net's features from the side to move perspective)
+// This is the trunk that policy nets built with -DPOLICY_SHARED_TRUNK read
+inline void stmAccumulator(const i64 *inputs, int numInputs, i16 *accumulator, int size)
+{
+    for (int i = 0; i < size; i++)
+        accumulator[i] = NET->featureBiases[i];
+
+    for (int j = 0; j < numInputs; j++)
+        for (int i = 0; i < size; i++)
+            accumulator[i] += NET->featureWeights[inputs[j] * HIDDEN_LAYER_SIZE + i];
+}
+
+// Centipawns from the side to move perspective, same as the engine
+inline i32 evaluate(BoardState &board)
+{
+    Accumulator accumulator = Accumulator(board);
+
+    Vec *stmAccumulator, *oppAccumulator;
+    if (board.sideToMove() == Color::WHITE) {
+        stmAccumulator = (Vec*)&accumulator.white;
+        oppAccumulator = (Vec*)&accumulator.black;
+    }
+    else {
+        stmAccumulator = (Vec*)&accumulator.black;
+        oppAccumulator = (Vec*)&accumulator.white;
+    }
+
+    Vec *stmWeights = (Vec*) &(NET->outputWeights[0]);
+    Vec *oppWeights = (Vec*) &(NET->outputWeights[1]);
+    const Vec vecZero = vecSetZero();
+    const Vec vecQA = vecSet1Epi16(QA);
+    Vec sum = vecSetZero();
+    Vec reg;
+
+    for (int i = 0; i < HIDDEN_LAYER_SIZE / WEIGHTS_PER_VEC; ++i) 
+    {
+        // Side to move
+        reg = maxEpi16(stmAccumulator[i], vecZero); // clip
+        reg = minEpi16(reg, vecQA); // clip
+        reg = mulloEpi16(reg, reg); // square
+        reg = maddEpi16(reg, stmWeights[i]); // multiply with output layer
+        sum = addEpi32(sum, reg); // collect the result
+
+        // Non side to move
+        reg = maxEpi16(oppAccumulator[i], vecZero);
+        reg = minEpi16(reg, vecQA);
+        reg = mulloEpi16(reg, reg);
+        reg = maddEpi16(reg, oppWeights[i]);
+        sum = addEpi32(sum, reg);
+    }
+
+    return (vecHaddEpi32(sum) / QA + NET->outputBias) * SCALE / (QA * QB);
+}
+
+} // namespace value_nnue
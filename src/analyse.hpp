@@ -0,0 +1,224 @@
+// clang-format off
+
+#pragma once
+
+// Offline analysis of EPD files, e.g. "analyse positions.epd results.jsonl nodes 10000 threads 8"
+// Positions are searched concurrently by independent searchers and results are written in input order,
+// one JSON object per line, with a progress file so a killed job resumes where it stopped
+
+#include <filesystem>
+#include <map>
+
+struct AnalyseSettings {
+    u64 nodes = 10000;
+    int threads = max((int)std::thread::hardware_concurrency(), 1);
+};
+
+// EPD lines have 4 FEN fields followed by operations, e.g. "<4 fields> bm e4; id \"1\";"
+// Full FENs are accepted too, otherwise the halfmove clock and move counter default to "0 1"
+inline std::string epdToFen(std::string line)
+{
+    std::vector<std::string> tokens = splitString(splitString(line, ';')[0], ' ');
+    if (tokens.size() < 4) return "";
+
+    std::string fen = tokens[0] + " " + tokens[1] + " " + tokens[2] + " " + tokens[3];
+
+    auto isNumber = [](std::string &str) {
+        return str.size() > 0 && std::all_of(str.begin(), str.end(), ::isdigit);
+    };
+
+    if (tokens.size() >= 6 && isNumber(tokens[4]) && isNumber(tokens[5]))
+        return fen + " " + tokens[4] + " " + tokens[5];
+
+    return fen + " 0 1";
+}
+
+// Searches a position and returns its result as a JSON object
+inline std::string analysePosition(Searcher &searcher, u64 positionIdx, std::string fen, u64 nodes)
+{
+    std::string json = "{\"position\":" + std::to_string(positionIdx + 1)
+                       + ",\"fen\":\"" + fen + "\"";
+
+    searcher.mBoard = Board(fen);
+    searcher.resetLimits(); // mNodes stays 0 if the position isn't searched
+
+    // The root of a search must be ongoing
+    std::vector<Move> moves = {};
+    searcher.mBoard.getMoves(moves);
+
+    if (moves.size() == 0)
+        return json + ",\"bestmove\":\"0000\",\"result\":\""
+               + (searcher.mBoard.inCheck() ? "checkmate" : "stalemate") + "\"}";
+
+    if (searcher.mBoard.isFiftyMovesDraw() || searcher.mBoard.isInsufficientMaterial())
+        return json + ",\"bestmove\":\"0000\",\"result\":\"draw\"}";
+
+    searcher.mMaxNodes = nodes;
+    Move bestMove = searcher.search(false);
+    auto [bestRootChild, bestRootMove] = searcher.mRoot.mostVisits();
+
+    json += ",\"nodes\":" + std::to_string(searcher.mNodes)
+            + ",\"bestmove\":\"" + bestMove.toUci() + "\""
+            + ",\"q\":" + roundToDecimalPlaces(bestRootChild->Q(), 4)
+            + ",\"score\":\"" + Searcher::uciScore(*bestRootChild) + "\""
+            + ",\"visits\":{";
+
+    // Root moves by visits, most visited first
+    Node &root = searcher.mRoot;
+    std::vector<int> childrenIdxs = {};
+    for (int i = 0; i < root.mChildren.size(); i++)
+        childrenIdxs.push_back(i);
+
+    std::stable_sort(childrenIdxs.begin(), childrenIdxs.end(), [&](int a, int b) {
+        return root.mChildren[a].mVisits > root.mChildren[b].mVisits;
+    });
+
+    for (int i : childrenIdxs)
+        json += (i == childrenIdxs[0] ? "\"" : ",\"") + root.mMoves[i].toUci() + "\":"
+                + std::to_string(root.mChildren[i].mVisits);
+
+    return json + "}}";
+}
+
+// The progress file holds the number of positions written and the output file size after them
+inline void writeAnalyseProgress(std::string progressFileName, u64 positionsWritten, u64 bytesWritten)
+{
+    // Write a temporary file and rename it, so a kill never leaves a partial progress file
+    std::string tmpFileName = progressFileName + ".tmp";
+    {
+        std::ofstream progressFile(tmpFileName, std::ios::trunc);
+        progressFile << positionsWritten << " " << bytesWritten << std::endl;
+    }
+    std::filesystem::rename(tmpFileName, progressFileName);
+}
+
+inline void analyse(std::string inFileName, std::string outFileName, AnalyseSettings settings = AnalyseSettings())
+{
+    std::ifstream inFile(inFileName);
+    if (!inFile.is_open()) {
+        std::cout << "Error opening " << inFileName << std::endl;
+        return;
+    }
+
+    // Resume from the progress file, dropping any output written after the last checkpoint
+    std::string progressFileName = outFileName + ".progress";
+    u64 positionsWritten = 0, bytesWritten = 0;
+
+    std::ifstream progressFileIn(progressFileName);
+    if (progressFileIn.is_open() && std::filesystem::exists(outFileName)
+    && (progressFileIn >> positionsWritten >> bytesWritten)
+    && bytesWritten <= std::filesystem::file_size(outFileName))
+    {
+        std::filesystem::resize_file(outFileName, bytesWritten);
+        std::cout << "Resuming after " << positionsWritten << " positions" << std::endl;
+    }
+    else
+        positionsWritten = bytesWritten = 0;
+
+    progressFileIn.close();
+
+    std::ofstream outFile(outFileName, positionsWritten > 0 ? std::ios::app : std::ios::trunc);
+    if (!outFile.is_open()) {
+        std::cout << "Error opening " << outFileName << std::endl;
+        return;
+    }
+
+    std::cout << "Analysing " << inFileName
+              << " with " << settings.nodes << " nodes per position"
+              << " and " << settings.threads << " threads"
+              << ", writing to " << outFileName
+              << std::endl;
+
+    std::mutex inMutex, outMutex;
+    u64 nextPositionIdx = 0; // guarded by inMutex
+    u64 nextToWrite = positionsWritten; // guarded by outMutex, as is bytesWritten
+    std::map<u64, std::string> pending = {}; // finished out of order, guarded by outMutex
+    std::atomic<u64> totalNodes = 0;
+
+    std::chrono::steady_clock::time_point start =  std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastCheckpoint = start;
+
+    // Next position to analyse and its index, skipping empty lines, comments and positions already written
+    auto nextPosition = [&](u64 &positionIdx, std::string &fen) -> bool
+    {
+        std::lock_guard<std::mutex> lock(inMutex);
+        std::string line;
+
+        while (std::getline(inFile, line))
+        {
+            trim(line);
+            if (line == "" || line[0] == '#') continue;
+
+            positionIdx = nextPositionIdx++;
+            if (positionIdx < positionsWritten) continue;
+
+            fen = epdToFen(line);
+            return true;
+        }
+
+        return false;
+    };
+
+    auto worker = [&]() {
+        Searcher searcher = Searcher(START_BOARD);
+        u64 positionIdx;
+        std::string fen;
+
+        while (nextPosition(positionIdx, fen))
+        {
+            std::string result = fen == ""
+                                 ? "{\"position\":" + std::to_string(positionIdx + 1) + ",\"error\":\"invalid epd\"}"
+                                 : analysePosition(searcher, positionIdx, fen, settings.nodes);
+
+            if (fen != "") totalNodes += searcher.mNodes;
+
+            std::lock_guard<std::mutex> lock(outMutex);
+            pending[positionIdx] = result;
+
+            // Write every consecutive finished result
+            bool wroteAny = false;
+            while (pending.size() > 0 && pending.begin()->first == nextToWrite)
+            {
+                outFile << pending.begin()->second << "\n";
+                bytesWritten += pending.begin()->second.size() + 1;
+                pending.erase(pending.begin());
+                nextToWrite++;
+                wroteAny = true;
+            }
+
+            if (wroteAny && millisecondsElapsed(lastCheckpoint) >= 1000) {
+                outFile.flush();
+                writeAnalyseProgress(progressFileName, nextToWrite, bytesWritten);
+                lastCheckpoint = std::chrono::steady_clock::now();
+
+                u64 msElapsed = millisecondsElapsed(start);
+                std::cout << "positions " << nextToWrite
+                          << " nps " << totalNodes * 1000 / max(msElapsed, (u64)1)
+                          << " time " << msElapsed
+                          << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < settings.threads; i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    outFile.flush();
+    outFile.close();
+
+    // Finished, so a new run starts over
+    std::filesystem::remove(progressFileName);
+
+    u64 msElapsed = millisecondsElapsed(start);
+    std::cout << "analyse positions " << nextToWrite - positionsWritten
+              << " nodes " << totalNodes
+              << " nps " << totalNodes * 1000 / max(msElapsed, (u64)1)
+              << " time " << msElapsed
+              << std::endl;
+}
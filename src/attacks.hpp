@@ -5,6 +5,10 @@
 #include "types.hpp"
 #include "utils.hpp"
 
+#if defined(__BMI2__)
+    #include <immintrin.h>
+#endif
+
 namespace attacks {
 
 namespace internal {
@@ -18,6 +22,17 @@ std::array<u64, 64> rookAttacksEmptyBoardNoEdges;   // [square]
 std::array<std::array<u64, 1ULL << 9ULL>, 64> bishopAttacksTable; // [square][index]
 std::array<std::array<u64, 1ULL << 12ULL>, 64> rookAttacksTable;  // [square][index]
 
+// PEXT tables are indexed by pext(occupancy) at a per-square offset, 
+// and store attacks compressed with pext, to be decompressed with pdep.
+// Both tables take ~210 KB, instead of ~2.3 MB for the magic tables.
+bool usePext = false;
+std::array<u64, 64> bishopAttacksEmptyBoard; // [square]
+std::array<u64, 64> rookAttacksEmptyBoard;   // [square]
+std::array<u32, 64> bishopPextOffsets; // [square]
+std::array<u32, 64> rookPextOffsets;   // [square]
+std::array<u16, 5248> bishopAttacksPextTable;  // [bishopPextOffsets[square] + index]
+std::array<u16, 102400> rookAttacksPextTable;  // [rookPextOffsets[square] + index]
+
 constexpr u64 pawnAttacksSlow(Color color, Square square)
 {
     const int SQUARE_DIAGONAL_LEFT  = square + (color == Color::WHITE ? 7 : -9),
@@ -196,6 +211,21 @@ constexpr u64 ROOK_MAGICS[64] = {
     0x489a000810200402ULL, 0x1004400080a13ULL, 0x4000011008020084ULL, 0x26002114058042ULL,
 };
 
+// Zen 1 and Zen 2 implement pext/pdep in microcode, so magics are faster there
+inline bool hasFastPext()
+{
+    #if defined(__BMI2__) && defined(__GNUC__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("bmi2")
+               && !__builtin_cpu_is("znver1") 
+               && !__builtin_cpu_is("znver2");
+    #elif defined(__BMI2__)
+        return true;
+    #else
+        return false;
+    #endif
+}
+
 } // namespace attacks::internal
 
 void init()
@@ -253,8 +283,44 @@ void init()
         }
     }
 
+    // Init PEXT slider tables
+    usePext = hasFastPext();
+    u32 bishopOffset = 0, rookOffset = 0;
+    for (Square sq = 0; sq < 64; sq++)
+    {
+        bishopAttacksEmptyBoard[sq] = bishopAttacksSlow(sq, 0ULL);
+        rookAttacksEmptyBoard[sq] = rookAttacksSlow(sq, 0ULL);
+        bishopPextOffsets[sq] = bishopOffset;
+        rookPextOffsets[sq] = rookOffset;
+
+        // Bishop
+        // pdep(n, mask) is the blockers arrangement whose pext index is n
+        u64 numBlockersArrangements = 1ULL << std::popcount(bishopAttacksEmptyBoardNoEdges[sq]);
+        for (u64 n = 0; n < numBlockersArrangements; n++)
+        {
+            u64 blockersArrangement = pdep(n, bishopAttacksEmptyBoardNoEdges[sq]);
+            u64 attacks = bishopAttacksSlow(sq, blockersArrangement);
+            bishopAttacksPextTable[bishopOffset + n] = pext(attacks, bishopAttacksEmptyBoard[sq]);
+        }
+        bishopOffset += numBlockersArrangements;
+
+        // Rook
+        numBlockersArrangements = 1ULL << std::popcount(rookAttacksEmptyBoardNoEdges[sq]);
+        for (u64 n = 0; n < numBlockersArrangements; n++)
+        {
+            u64 blockersArrangement = pdep(n, rookAttacksEmptyBoardNoEdges[sq]);
+            u64 attacks = rookAttacksSlow(sq, blockersArrangement);
+            rookAttacksPextTable[rookOffset + n] = pext(attacks, rookAttacksEmptyBoard[sq]);
+        }
+        rookOffset += numBlockersArrangements;
+    }
+
+    assert(bishopOffset == bishopAttacksPextTable.size());
+    assert(rookOffset == rookAttacksPextTable.size());
 }
 
+inline bool isPextEnabled() { return internal::usePext; }
+
 inline u64 pawnAttacks(Color color, Square square) {
     return internal::pawnAttacks[(int)color][square];
 }
@@ -270,6 +336,15 @@ inline u64 kingAttacks(Square square)  {
 inline u64 bishopAttacks(Square square, u64 occupancy)
 {
     using namespace internal;
+
+    #if defined(__BMI2__)
+        if (usePext) {
+            u64 index = _pext_u64(occupancy, bishopAttacksEmptyBoardNoEdges[square]);
+            u16 attacks = bishopAttacksPextTable[bishopPextOffsets[square] + index];
+            return _pdep_u64(attacks, bishopAttacksEmptyBoard[square]);
+        }
+    #endif
+
     u64 blockers = occupancy & bishopAttacksEmptyBoardNoEdges[square];
     u64 index = (blockers * BISHOP_MAGICS[square]) >> BISHOP_SHIFTS[square];
     return bishopAttacksTable[square][index];
@@ -278,6 +353,15 @@ inline u64 bishopAttacks(Square square, u64 occupancy)
 inline u64 rookAttacks(Square square, u64 occupancy)
 {
     using namespace internal;
+
+    #if defined(__BMI2__)
+        if (usePext) {
+            u64 index = _pext_u64(occupancy, rookAttacksEmptyBoardNoEdges[square]);
+            u16 attacks = rookAttacksPextTable[rookPextOffsets[square] + index];
+            return _pdep_u64(attacks, rookAttacksEmptyBoard[square]);
+        }
+    #endif
+
     u64 blockers = occupancy & rookAttacksEmptyBoardNoEdges[square];
     u64 index = (blockers * ROOK_MAGICS[square]) >> ROOK_SHIFTS[square];
     return rookAttacksTable[square][index];
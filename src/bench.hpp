@@ -51,22 +51,64 @@ const std::array FENS {
     "2r2b2/5p2/5k2/p1r1pP2/P2pB3/1P3P2/K1P3R1/7R w - - 23 93"
 };
 
-inline void bench(int maxAvgDepth = 14)
+// With threads > 1, each root parallel tree searches to maxAvgDepth
+// With evalThreads > 0, all trees share that many evaluator threads
+inline void bench(int maxAvgDepth = 14, bool usePerfCounters = false, int threads = 1, int evalThreads = 0)
 {
     std::cout << "Running bench depth " << maxAvgDepth 
               << " on " << FENS.size() << " positions" 
+              << " with " << threads << " threads"
+              << " and " << evalThreads << " eval threads"
               << std::endl;
 
     u64 totalNodes = 0;
     u64 totalMilliseconds = 0;
+    profile::Stats profileStats = profile::Stats();
 
-    for (const std::string &fen : FENS)
+    // Only opened if asked for, since it costs a syscall per event
+    std::unique_ptr<perf_counters::PerfCounters> perfCounters = usePerfCounters
+        ? std::make_unique<perf_counters::PerfCounters>() : nullptr;
+    perf_counters::Counts totalCounts = perf_counters::Counts();
+
+    if (usePerfCounters && !perfCounters->anyAvailable()) {
+        std::cout << "Perf events unavailable (" << perfCounters->error() << ")"
+                  << ", running bench without hardware counters" 
+                  << std::endl;
+        usePerfCounters = false;
+    }
+
+    // Child threads' counts are only added to the counters once they exit, so with perf counters
+    // the evaluator threads live for 1 position instead of the whole bench
+    std::shared_ptr<EvalPool> evalPool = evalThreads > 0 && !usePerfCounters
+        ? std::make_shared<EvalPool>(evalThreads) : nullptr;
+
+    for (int i = 0; i < FENS.size(); i++)
     {
-        Searcher searcher = Searcher(Board(fen));
+        Searcher searcher = Searcher(Board(FENS[i]));
         searcher.resetLimits();
+        searcher.mThreads = threads;
+        searcher.mEvalPool = evalPool;
+
+        if (usePerfCounters) {
+            perfCounters->start();
+            if (evalThreads > 0) searcher.mEvalPool = std::make_shared<EvalPool>(evalThreads);
+        }
+
         searcher.search(false, maxAvgDepth);
-        totalNodes += searcher.mNodes;
+
+        totalNodes += searcher.totalNodes();
         totalMilliseconds += millisecondsElapsed(searcher.mStartTime);
+        profileStats.add(searcher.mProfileStats);
+
+        if (usePerfCounters) {
+            searcher.mEvalPool = nullptr; // Joins the evaluator threads, helpers dropped theirs
+            perf_counters::Counts counts = perfCounters->stop();
+            totalCounts.add(counts);
+            std::cout << "position " << i + 1 << "/" << FENS.size()
+                      << " nodes " << searcher.totalNodes()
+                      << " " << counts.toString(searcher.totalNodes())
+                      << std::endl;
+        }
     }
 
     std::cout << "bench depth " << maxAvgDepth
@@ -74,4 +116,71 @@ inline void bench(int maxAvgDepth = 14)
               << " nps " << totalNodes * 1000 / max((u64)totalMilliseconds, (u64)1)
               << " time " << totalMilliseconds
               << std::endl;
-}
\ No newline at end of file
+
+    if (usePerfCounters)
+        std::cout << "perf " << totalCounts.toString(totalNodes) << std::endl;
+
+    if (profile::isEnabled())
+        profile::print(profileStats);
+}
+
+// Searches each position for a fixed number of nodes and prints one JSON object per line,
+// ending with a signature of the best moves and their visits, which only changes if the search does
+// With threads > 1, the nodes are split between the root parallel trees and the visits are merged
+inline void jsonBench(u64 nodesPerPosition = 10000, int threads = 1, int evalThreads = 0)
+{
+    std::shared_ptr<EvalPool> evalPool = evalThreads > 0 ? std::make_shared<EvalPool>(evalThreads) : nullptr;
+
+    u64 totalNodes = 0;
+    u64 totalMilliseconds = 0;
+    u64 signature = 14695981039346656037ULL; // FNV-1a offset basis
+
+    auto hashIntoSignature = [&](u64 value) {
+        for (int i = 0; i < 8; i++) {
+            signature ^= (value >> (i * 8)) & 0xFF;
+            signature *= 1099511628211ULL; // FNV-1a prime
+        }
+    };
+
+    for (int i = 0; i < FENS.size(); i++)
+    {
+        Searcher searcher = Searcher(Board(FENS[i]));
+        searcher.resetLimits();
+        searcher.mMaxNodes = nodesPerPosition;
+        searcher.mThreads = threads;
+        searcher.mEvalPool = evalPool;
+        searcher.mRecordTreeBytes = true;
+        Move bestMove = searcher.search(false);
+
+        u64 msElapsed = millisecondsElapsed(searcher.mStartTime);
+        RootMoveStats bestMoveStats = searcher.bestRootMove();
+        u64 nodes = searcher.totalNodes();
+
+        totalNodes += nodes;
+        totalMilliseconds += msElapsed;
+        hashIntoSignature(nodes);
+        hashIntoSignature(bestMove.getMoveEncoded());
+        hashIntoSignature(bestMoveStats.visits);
+
+        std::cout << "{\"position\":" << i + 1
+                  << ",\"fen\":\"" << FENS[i] << "\""
+                  << ",\"nodes\":" << nodes
+                  << ",\"bestmove\":\"" << bestMove.toUci() << "\""
+                  << ",\"bestmove_visits\":" << bestMoveStats.visits
+                  << ",\"time_ms\":" << msElapsed
+                  << ",\"nps\":" << nodes * 1000 / max(msElapsed, (u64)1)
+                  << ",\"tree_bytes\":" << searcher.mTreeBytes
+                  << "}" << std::endl;
+    }
+
+    std::cout << "{\"bench\":\"nodes\""
+              << ",\"nodes_per_position\":" << nodesPerPosition
+              << ",\"threads\":" << threads
+              << ",\"eval_threads\":" << evalThreads
+              << ",\"positions\":" << FENS.size()
+              << ",\"nodes\":" << totalNodes
+              << ",\"time_ms\":" << totalMilliseconds
+              << ",\"nps\":" << totalNodes * 1000 / max(totalMilliseconds, (u64)1)
+              << ",\"signature\":\"" << std::hex << signature << std::dec << "\""
+              << "}" << std::endl;
+}
@@ -46,6 +46,10 @@ struct BoardState
     Move mLastMove;
     value_nnue::Accumulator mAccumulator;
 
+    // Attack maps of this position, computed lazily and invalidated by makeMove()
+    u64 mThreats, mCheckers, mPinnedNonDiagonal, mPinnedDiagonal;
+    bool mThreatsAndPinsComputed = false, mCheckersComputed = false;
+
     public:
 
     inline BoardState() = default;
@@ -198,17 +202,13 @@ struct BoardState
         mAccumulator.activate(color, pieceType, square);
     }
 
-    inline void removePiece(Square square) {
-        Color color = colorAt(square);
-        if (color != Color::NONE)
-        {
-            u64 sqBitboard = 1ULL << square;
-            PieceType pt = pieceTypeAt(square);
-            mColorBitboard[(int)color] ^= sqBitboard;
-            mPiecesBitboards[(int)pt] ^= sqBitboard;
-            mZobristHash ^= ZOBRIST_PIECES[(int)color][(int)pt][square];
-            mAccumulator.deactivate(color, pt, square);
-        }
+    inline void removePiece(Color color, PieceType pieceType, Square square) {
+        assert(colorAt(square) == color && pieceTypeAt(square) == pieceType);
+        u64 sqBitboard = 1ULL << square;
+        mColorBitboard[(int)color] ^= sqBitboard;
+        mPiecesBitboards[(int)pieceType] ^= sqBitboard;
+        mZobristHash ^= ZOBRIST_PIECES[(int)color][(int)pieceType][square];
+        mAccumulator.deactivate(color, pieceType, square);
     }
 
     public:
@@ -351,12 +351,7 @@ struct BoardState
         return false;
     }   
 
-    inline bool inCheck()
-    {
-        u64 ourKingBitboard = getBitboard(mColorToMove, PieceType::KING);
-        Square ourKingSquare = lsb(ourKingBitboard);
-        return isSquareAttacked(ourKingSquare, oppSide());
-    }
+    inline bool inCheck() { return checkers() > 0; }
 
     inline u64 attackers(Square sq, Color colorAttacking) 
     {
@@ -373,75 +368,96 @@ struct BoardState
         return attackers & getBitboard(colorAttacking);
     }
 
-    inline u64 checkers() {
-        u8 kingSquare = lsb(getBitboard(mColorToMove, PieceType::KING));
-        return attackers(kingSquare, oppSide());
+    inline u64 checkers() 
+    {
+        if (!mCheckersComputed) {
+            u8 kingSquare = lsb(getBitboard(mColorToMove, PieceType::KING));
+            mCheckers = attackers(kingSquare, oppSide());
+            mCheckersComputed = true;
+        }
+
+        return mCheckers;
     }
 
     // returns pinned non diagonal, pinned diagonal
     inline std::pair<u64, u64> pinned()
     {
-        u64 kingSquare = lsb(getBitboard(mColorToMove, PieceType::KING));
+        if (!mThreatsAndPinsComputed) computeThreatsAndPins();
+        return { mPinnedNonDiagonal, mPinnedDiagonal };
+    }
+
+    // Squares attacked by the enemy, with our king removed from the occupancy
+    inline u64 threats()
+    {
+        if (!mThreatsAndPinsComputed) computeThreatsAndPins();
+        return mThreats;
+    }
+
+    private:
+
+    inline void computeThreatsAndPins()
+    {
+        u64 kingBb = getBitboard(mColorToMove, PieceType::KING);
+        u64 kingSquare = lsb(kingBb);
+        Color oppColor = oppSide();
 
-        u64 pinnedNonDiagonal = 0;
+        // Pins
+
+        mPinnedNonDiagonal = 0;
         u64 pinnersNonDiagonal = (getBitboard(PieceType::ROOK) | getBitboard(PieceType::QUEEN))
                                  & attacks::xrayRook(kingSquare, occupancy(), us()) & them();
 
-        
         while (pinnersNonDiagonal) {
             u8 pinnerSquare = poplsb(pinnersNonDiagonal);
-            pinnedNonDiagonal |= IN_BETWEEN[pinnerSquare][kingSquare] & us();
+            mPinnedNonDiagonal |= IN_BETWEEN[pinnerSquare][kingSquare] & us();
         }
 
-        u64 pinnedDiagonal = 0;
+        mPinnedDiagonal = 0;
         u64 pinnersDiagonal = (getBitboard(PieceType::BISHOP) | getBitboard(PieceType::QUEEN))
                               & attacks::xrayBishop(kingSquare, occupancy(), us()) & them();
 
         while (pinnersDiagonal) {
             u8 pinnerSquare = poplsb(pinnersDiagonal);
-            pinnedDiagonal |= IN_BETWEEN[pinnerSquare][kingSquare] & us();
+            mPinnedDiagonal |= IN_BETWEEN[pinnerSquare][kingSquare] & us();
         }
 
-        return { pinnedNonDiagonal, pinnedDiagonal };
-    }
+        // Threats
 
-    inline u64 threats()
-    {
-        u64 threats = 0;
-        u64 kingBb = getBitboard(mColorToMove, PieceType::KING);
+        mThreats = 0;
         u64 occ = occupancy() ^ kingBb;
-        Color oppColor = oppSide();
 
         u64 enemyRooks = getBitboard(oppColor, PieceType::ROOK) | getBitboard(oppColor, PieceType::QUEEN);
         while (enemyRooks) {
             u8 sq = poplsb(enemyRooks);
-            threats |= attacks::rookAttacks(sq, occ);
+            mThreats |= attacks::rookAttacks(sq, occ);
         }
 
         u64 enemyBishops = getBitboard(oppColor, PieceType::BISHOP) | getBitboard(oppColor, PieceType::QUEEN);
         while (enemyBishops) {
             u8 sq = poplsb(enemyBishops);
-            threats |= attacks::bishopAttacks(sq, occ);
+            mThreats |= attacks::bishopAttacks(sq, occ);
         }
 
         u64 enemyKnights = getBitboard(oppColor, PieceType::KNIGHT);
         while (enemyKnights) {
             u8 sq = poplsb(enemyKnights);
-            threats |= attacks::knightAttacks(sq);
+            mThreats |= attacks::knightAttacks(sq);
         }
 
         u64 enemyPawns = getBitboard(oppColor, PieceType::PAWN);
         while (enemyPawns) {
             u8 sq = poplsb(enemyPawns);
-            threats |= attacks::pawnAttacks(oppColor, sq);
+            mThreats |= attacks::pawnAttacks(oppColor, sq);
         }
 
         u8 enemyKingSquare = lsb(getBitboard(oppColor, PieceType::KING));
-        threats |= attacks::kingAttacks(enemyKingSquare);
+        mThreats |= attacks::kingAttacks(enemyKingSquare);
 
-        return threats;
+        mThreatsAndPinsComputed = true;
     }
 
+    public:
+
     inline bool isSlider(Square sq)
     {
         u64 squareBb = 1ULL << sq;
@@ -452,12 +468,34 @@ struct BoardState
 
     inline void getMoves(std::vector<Move> &moves, bool underpromotions = true)
     {
+        if (mColorToMove == Color::WHITE)
+            getMoves<Color::WHITE>(moves, underpromotions);
+        else
+            getMoves<Color::BLACK>(moves, underpromotions);
+    }
+
+    template <Color stm>
+    inline void getMoves(std::vector<Move> &moves, bool underpromotions)
+    {
+        assert(stm == mColorToMove);
+
+        constexpr Color enemyColor = stm == Color::WHITE ? Color::BLACK : Color::WHITE;
+
+        // Pawn move offsets, with left = towards the A file
+        constexpr int UP = stm == Color::WHITE ? 8 : -8,
+                      UP_LEFT = stm == Color::WHITE ? 7 : -9,
+                      UP_RIGHT = stm == Color::WHITE ? 9 : -7;
+
+        constexpr u64 PROMOTION_RANK_BB = stm == Color::WHITE ? RANK_8_BB : RANK_1_BB,
+                      DOUBLE_PUSH_RANK_BB = stm == Color::WHITE ? RANK_3_BB : RANK_6_BB;
+
         moves = {};
         u64 threats = this->threats();
+        u64 us = getBitboard(stm), them = getBitboard(enemyColor);
 
         // King moves
-        u8 kingSquare = lsb(getBitboard(mColorToMove, PieceType::KING));
-        u64 targetSquares = attacks::kingAttacks(kingSquare) & ~us() & ~threats;
+        u8 kingSquare = lsb(getBitboard(stm, PieceType::KING));
+        u64 targetSquares = attacks::kingAttacks(kingSquare) & ~us & ~threats;
         while (targetSquares) {
             u8 targetSquare = poplsb(targetSquares);
             moves.push_back(Move(kingSquare, targetSquare, Move::KING_FLAG));
@@ -478,135 +516,118 @@ struct BoardState
                 movableBb |= IN_BETWEEN[kingSquare][checkerSquare];
         }
 
-        Color enemyColor = oppSide();
         auto [pinnedNonDiagonal, pinnedDiagonal] = pinned();
 
-        u64 ourPawns = getBitboard(mColorToMove, PieceType::PAWN),
-            ourKnights = getBitboard(mColorToMove, PieceType::KNIGHT) 
+        u64 ourPawns = getBitboard(stm, PieceType::PAWN),
+            ourKnights = getBitboard(stm, PieceType::KNIGHT) 
                          & ~pinnedDiagonal & ~pinnedNonDiagonal,
-            ourBishops = getBitboard(mColorToMove, PieceType::BISHOP) & ~pinnedNonDiagonal,
-            ourRooks = getBitboard(mColorToMove, PieceType::ROOK) & ~pinnedDiagonal,
-            ourQueens = getBitboard(mColorToMove, PieceType::QUEEN),
-            ourKing = getBitboard(mColorToMove, PieceType::KING);
+            ourBishops = getBitboard(stm, PieceType::BISHOP) & ~pinnedNonDiagonal,
+            ourRooks = getBitboard(stm, PieceType::ROOK) & ~pinnedDiagonal,
+            ourQueens = getBitboard(stm, PieceType::QUEEN);
+
+        u64 occ = occupancy();
 
         // En passant
         if (mEnPassantSquare != SQUARE_NONE)
         {
             u64 ourNearbyPawns = ourPawns & attacks::pawnAttacks(enemyColor, mEnPassantSquare);
+            u64 capturedPawnBb = 1ULL << (mEnPassantSquare - UP);
+            u64 enemyRooksQueens = getBitboard(enemyColor, PieceType::ROOK) 
+                                   | getBitboard(enemyColor, PieceType::QUEEN);
+            u64 enemyBishopsQueens = getBitboard(enemyColor, PieceType::BISHOP) 
+                                     | getBitboard(enemyColor, PieceType::QUEEN);
+
             while (ourNearbyPawns) {
                 u8 ourPawnSquare = poplsb(ourNearbyPawns);
-                auto _zobristHash = mZobristHash;
-                auto _colorBitboard = mColorBitboard;
-                auto _piecesBitboards = mPiecesBitboards;
-
-                // Make the en passant move
-                removePiece(ourPawnSquare);
-                placePiece(mColorToMove, PieceType::PAWN, mEnPassantSquare);
-                Square capturedPawnSquare = mColorToMove == Color::WHITE
-                                            ? mEnPassantSquare - 8 : mEnPassantSquare + 8;
-                removePiece(capturedPawnSquare);
-
-                if (!inCheck())
+
+                // Occupancy after the en passant move
+                u64 occAfter = occ ^ (1ULL << ourPawnSquare) 
+                               ^ (1ULL << mEnPassantSquare) ^ capturedPawnBb;
+
+                u64 checkersAfter = (enemyRooksQueens & attacks::rookAttacks(kingSquare, occAfter))
+                                    | (enemyBishopsQueens & attacks::bishopAttacks(kingSquare, occAfter))
+                                    | (getBitboard(enemyColor, PieceType::KNIGHT) & attacks::knightAttacks(kingSquare))
+                                    | (getBitboard(enemyColor, PieceType::PAWN) & ~capturedPawnBb
+                                       & attacks::pawnAttacks(stm, kingSquare));
+
+                if (checkersAfter == 0)
                     // en passant is legal
                     moves.push_back(Move(ourPawnSquare, mEnPassantSquare, Move::EN_PASSANT_FLAG));
-
-                // Undo the en passant move
-                mZobristHash = _zobristHash;
-                mColorBitboard = _colorBitboard;
-                mPiecesBitboards = _piecesBitboards;
             }
         }
 
         // Castling
         if (numCheckers == 0)
         {
-            if ((mCastlingRights & CASTLING_MASKS[(int)mColorToMove][CASTLE_SHORT])
-            && !isOccupied(kingSquare + 1)
-            && !isOccupied(kingSquare + 2)
-            && !isSquareAttacked(kingSquare+1, enemyColor) 
-            && !isSquareAttacked(kingSquare+2, enemyColor))
+            if ((mCastlingRights & CASTLING_MASKS[(int)stm][CASTLE_SHORT])
+            && !(occ & (0b11ULL << (kingSquare + 1)))
+            && !(threats & (0b11ULL << (kingSquare + 1))))
                 moves.push_back(Move(kingSquare, kingSquare + 2, Move::CASTLING_FLAG));
 
-            if ((mCastlingRights & CASTLING_MASKS[(int)mColorToMove][CASTLE_LONG])
-            && !isOccupied(kingSquare - 1)
-            && !isOccupied(kingSquare - 2)
-            && !isOccupied(kingSquare - 3)
-            && !isSquareAttacked(kingSquare-1, enemyColor) 
-            && !isSquareAttacked(kingSquare-2, enemyColor))
+            if ((mCastlingRights & CASTLING_MASKS[(int)stm][CASTLE_LONG])
+            && !(occ & (0b111ULL << (kingSquare - 3)))
+            && !(threats & (0b11ULL << (kingSquare - 2))))
                 moves.push_back(Move(kingSquare, kingSquare - 2, Move::CASTLING_FLAG));
         }
 
-        while (ourPawns > 0)
-        {
-            Square sq = poplsb(ourPawns);
-            u64 sqBb = 1ULL << sq;
-            bool pawnHasntMoved = false, willPromote = false;
-            Rank rank = squareRank(sq);
-
-            if (rank == Rank::RANK_2) {
-                pawnHasntMoved = mColorToMove == Color::WHITE;
-                willPromote = mColorToMove == Color::BLACK;
-            } else if (rank == Rank::RANK_7) {
-                pawnHasntMoved = mColorToMove == Color::BLACK;
-                willPromote = mColorToMove == Color::WHITE;
-            }
+        // Pawn captures, set-wise for pawns that aren't pinned
 
-            // Generate this pawn's captures 
+        u64 captureTargets = them & movableBb;
+        u64 capturers = ourPawns & ~pinnedDiagonal & ~pinnedNonDiagonal;
 
-            u64 pawnAttacks = attacks::pawnAttacks(mColorToMove, sq) & them() & movableBb;
-            if (sqBb & (pinnedDiagonal | pinnedNonDiagonal)) 
-                pawnAttacks &= LINE_THROUGH[kingSquare][sq];
+        addPawnMoves<UP_LEFT>(moves, 
+            shift<UP_LEFT>(capturers & ~FILE_A_BB) & captureTargets, 
+            PROMOTION_RANK_BB, underpromotions);
+
+        addPawnMoves<UP_RIGHT>(moves, 
+            shift<UP_RIGHT>(capturers & ~FILE_H_BB) & captureTargets, 
+            PROMOTION_RANK_BB, underpromotions);
+
+        // A pawn pinned diagonally can only capture along the pin ray
+        u64 pinnedCapturers = ourPawns & pinnedDiagonal;
+        while (pinnedCapturers > 0) {
+            Square sq = poplsb(pinnedCapturers);
+            u64 pawnAttacks = attacks::pawnAttacks(stm, sq) & captureTargets 
+                              & LINE_THROUGH[kingSquare][sq];
 
             while (pawnAttacks > 0) {
                 Square targetSquare = poplsb(pawnAttacks);
-                if (willPromote) 
+                if ((1ULL << targetSquare) & PROMOTION_RANK_BB)
                     addPromotions(moves, sq, targetSquare, underpromotions);
                 else 
                     moves.push_back(Move(sq, targetSquare, Move::PAWN_FLAG));
             }
+        }
 
-            // Generate this pawn's pushes 
+        // Pawn pushes, set-wise
+        // A pawn pinned non diagonally can only push if pinned along the king's file
 
-            if (sqBb & pinnedDiagonal) continue;
-            u64 pinRay = LINE_THROUGH[sq][kingSquare];
-            bool pinnedHorizontally = (sqBb & pinnedNonDiagonal) && (pinRay & (pinRay << 1)) > 0;
-            if (pinnedHorizontally) continue;
+        u64 empty = ~occ;
+        u64 pushers = ourPawns & ~pinnedDiagonal 
+                      & ~(pinnedNonDiagonal & ~(FILE_A_BB << (int)squareFile(kingSquare)));
 
-            Square squareOneUp = mColorToMove == Color::WHITE ? sq + 8 : sq - 8;
-            if (isOccupied(squareOneUp)) continue;
+        u64 singlePushes = shift<UP>(pushers) & empty;
+        u64 doublePushes = shift<UP>(singlePushes & DOUBLE_PUSH_RANK_BB) & empty & movableBb;
 
-            if (movableBb & (1ULL << squareOneUp))
-            {
-                if (willPromote) {
-                    addPromotions(moves, sq, squareOneUp, underpromotions);
-                    continue;
-                }
-                moves.push_back(Move(sq, squareOneUp, Move::PAWN_FLAG));
-            }
-
-            if (!pawnHasntMoved) continue;
+        addPawnMoves<UP>(moves, singlePushes & movableBb, PROMOTION_RANK_BB, underpromotions);
 
-            Square squareTwoUp = mColorToMove == Color::WHITE 
-                                 ? sq + 16 : sq - 16;
-
-            if ((movableBb & (1ULL << squareTwoUp)) && !isOccupied(squareTwoUp))
-                moves.push_back(Move(sq, squareTwoUp, Move::PAWN_TWO_UP_FLAG));
+        while (doublePushes > 0) {
+            Square targetSquare = poplsb(doublePushes);
+            moves.push_back(Move(targetSquare - 2 * UP, targetSquare, Move::PAWN_TWO_UP_FLAG));
         }
 
         while (ourKnights > 0) {
             Square sq = poplsb(ourKnights);
-            u64 knightMoves = attacks::knightAttacks(sq) & ~us() & movableBb;
+            u64 knightMoves = attacks::knightAttacks(sq) & ~us & movableBb;
             while (knightMoves > 0) {
                 Square targetSquare = poplsb(knightMoves);
                 moves.push_back(Move(sq, targetSquare, Move::KNIGHT_FLAG));
             }
         }
 
-        u64 occ = occupancy();
-        
         while (ourBishops > 0) {
             Square sq = poplsb(ourBishops);
-            u64 bishopMoves = attacks::bishopAttacks(sq, occ) & ~us() & movableBb;
+            u64 bishopMoves = attacks::bishopAttacks(sq, occ) & ~us & movableBb;
             if ((1ULL << sq) & pinnedDiagonal)
                 bishopMoves &= LINE_THROUGH[kingSquare][sq];
             while (bishopMoves > 0) {
@@ -617,7 +638,7 @@ struct BoardState
 
         while (ourRooks > 0) {
             Square sq = poplsb(ourRooks);
-            u64 rookMoves = attacks::rookAttacks(sq, occ) & ~us() & movableBb;
+            u64 rookMoves = attacks::rookAttacks(sq, occ) & ~us & movableBb;
             if ((1ULL << sq) & pinnedNonDiagonal)
                 rookMoves &= LINE_THROUGH[kingSquare][sq];
             while (rookMoves > 0) {
@@ -628,7 +649,7 @@ struct BoardState
 
         while (ourQueens > 0) {
             Square sq = poplsb(ourQueens);
-            u64 queenMoves = attacks::queenAttacks(sq, occ) & ~us() & movableBb;
+            u64 queenMoves = attacks::queenAttacks(sq, occ) & ~us & movableBb;
             if ((1ULL << sq) & (pinnedDiagonal | pinnedNonDiagonal))
                 queenMoves &= LINE_THROUGH[kingSquare][sq];
             while (queenMoves > 0) {
@@ -640,6 +661,30 @@ struct BoardState
 
     private:
 
+    template <int offset>
+    static constexpr u64 shift(u64 bb) {
+        return offset > 0 ? bb << offset : bb >> -offset;
+    }
+
+    // Adds the pawn moves landing on targetSquares, all made from (targetSquare - offset)
+    template <int offset>
+    inline void addPawnMoves(std::vector<Move> &moves, u64 targetSquares, 
+                             u64 promotionRankBb, bool underpromotions)
+    {
+        u64 promotions = targetSquares & promotionRankBb;
+        targetSquares &= ~promotionRankBb;
+
+        while (targetSquares > 0) {
+            Square targetSquare = poplsb(targetSquares);
+            moves.push_back(Move(targetSquare - offset, targetSquare, Move::PAWN_FLAG));
+        }
+
+        while (promotions > 0) {
+            Square targetSquare = poplsb(promotions);
+            addPromotions(moves, targetSquare - offset, targetSquare, underpromotions);
+        }
+    }
+
     inline void addPromotions(std::vector<Move> &moves, Square sq, Square targetSquare, bool underpromotions)
     {
         moves.push_back(Move(sq, targetSquare, Move::QUEEN_PROMOTION_FLAG));
@@ -652,39 +697,58 @@ struct BoardState
 
     public:
 
+    inline void makeMove(Move move)
+    {
+        if (mColorToMove == Color::WHITE)
+            makeMove<Color::WHITE>(move);
+        else
+            makeMove<Color::BLACK>(move);
+    }
+
+    template <Color stm>
     inline void makeMove(Move move)
     {
         assert(move != MOVE_NONE);
+        assert(stm == mColorToMove);
+
+        constexpr Color enemyColor = stm == Color::WHITE ? Color::BLACK : Color::WHITE;
+        constexpr int UP = stm == Color::WHITE ? 8 : -8;
+
         Square from = move.from();
         Square to = move.to();
         auto moveFlag = move.flag();
         PieceType pieceType = move.pieceType();
-        PieceType promotion = move.promotion();
-        bool isCapture = this->isCapture(move);
-        Color oppSide = this->oppSide();
+        bool isCapture = false;
 
-        removePiece(from);
+        removePiece(stm, pieceType, from);
 
-        if (moveFlag == Move::CASTLING_FLAG)
-        {
-            placePiece(mColorToMove, PieceType::KING, to);
-            auto [rookFrom, rookTo] = CASTLING_ROOK_FROM_TO[to];
-            removePiece(rookFrom);
-            placePiece(mColorToMove, PieceType::ROOK, rookTo);
-        }
-        else if (moveFlag == Move::EN_PASSANT_FLAG)
-        {
-            Square capturedPawnSquare = mColorToMove == Color::WHITE
-                                        ? to - 8 : to + 8;
-            removePiece(capturedPawnSquare);
-            placePiece(mColorToMove, PieceType::PAWN, to);
-        }
-        else
+        switch (moveFlag)
         {
-            if (isCapture)
-                removePiece(to);
-            PieceType place = promotion != PieceType::NONE ? promotion : pieceType;
-            placePiece(mColorToMove, place, to);
+            case Move::CASTLING_FLAG:
+            {
+                placePiece(stm, PieceType::KING, to);
+                auto [rookFrom, rookTo] = CASTLING_ROOK_FROM_TO[to];
+                removePiece(stm, PieceType::ROOK, rookFrom);
+                placePiece(stm, PieceType::ROOK, rookTo);
+                break;
+            }
+            case Move::EN_PASSANT_FLAG:
+                removePiece(enemyColor, PieceType::PAWN, to - UP);
+                placePiece(stm, PieceType::PAWN, to);
+                isCapture = true;
+                break;
+            case Move::KNIGHT_PROMOTION_FLAG:
+            case Move::BISHOP_PROMOTION_FLAG:
+            case Move::ROOK_PROMOTION_FLAG:
+            case Move::QUEEN_PROMOTION_FLAG:
+                isCapture = getBitboard(enemyColor) & (1ULL << to);
+                if (isCapture) removePiece(enemyColor, pieceTypeAt(to), to);
+                placePiece(stm, move.promotion(), to);
+                break;
+            default:
+                isCapture = getBitboard(enemyColor) & (1ULL << to);
+                if (isCapture) removePiece(enemyColor, pieceTypeAt(to), to);
+                placePiece(stm, pieceType, to);
         }
 
         mZobristHash ^= mCastlingRights; // XOR old castling rights out
@@ -692,8 +756,8 @@ struct BoardState
         // Update castling rights
         if (pieceType == PieceType::KING)
         {
-            mCastlingRights &= ~CASTLING_MASKS[(int)mColorToMove][CASTLE_SHORT]; 
-            mCastlingRights &= ~CASTLING_MASKS[(int)mColorToMove][CASTLE_LONG]; 
+            mCastlingRights &= ~CASTLING_MASKS[(int)stm][CASTLE_SHORT]; 
+            mCastlingRights &= ~CASTLING_MASKS[(int)stm][CASTLE_LONG]; 
         }
         else if ((1ULL << from) & mCastlingRights)
             mCastlingRights &= ~(1ULL << from);
@@ -710,14 +774,13 @@ struct BoardState
         }
         if (moveFlag == Move::PAWN_TWO_UP_FLAG)
         { 
-            mEnPassantSquare = mColorToMove == Color::WHITE
-                              ? to - 8 : to + 8;
+            mEnPassantSquare = to - UP;
             mZobristHash ^= ZOBRIST_FILES[(int)squareFile(mEnPassantSquare)];
         }
 
-        mZobristHash ^= ZOBRIST_COLOR[(int)mColorToMove];
-        mColorToMove = oppSide;
-        mZobristHash ^= ZOBRIST_COLOR[(int)mColorToMove];
+        mZobristHash ^= ZOBRIST_COLOR[(int)stm];
+        mColorToMove = enemyColor;
+        mZobristHash ^= ZOBRIST_COLOR[(int)enemyColor];
 
         if (pieceType == PieceType::PAWN || isCapture) {
             mPliesSincePawnOrCapture = 0;
@@ -726,10 +789,11 @@ struct BoardState
             mPliesSincePawnOrCapture++;
         }
 
-        if (mColorToMove == Color::WHITE)
+        if constexpr (stm == Color::BLACK)
             mMoveCounter++;
 
         mLastMove = move;
+        mThreatsAndPinsComputed = mCheckersComputed = false;
     }
 
     inline Move uciToMove(std::string uciMove)
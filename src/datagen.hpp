@@ -0,0 +1,239 @@
+// clang-format off
+
+#pragma once
+
+// Self-play data generation, e.g. "datagen selfplay.bin nodes 1000 threads 8 positions 10000000"
+// Each thread plays games against itself with a fixed node budget per move and writes
+// every searched position in the converter's binary format, followed by visits and game result:
+//     i8 stm
+//     u8 numActiveInputs, i16 activeInputs[numActiveInputs] (sorted)
+//     u8 numMoves, i16 moves4096[numMoves] (sorted, no underpromotions)
+//     u16 bestMove4096 (the move played)
+//     u16 visits[numMoves] (root visits of each move in moves4096, scaled to fit u16)
+//     i8 result (from stm perspective, 1 = win, 0 = draw, -1 = loss)
+
+#include <random>
+
+struct DatagenSettings {
+    u64 nodes = 1000;
+    int threads = max((int)std::thread::hardware_concurrency(), 1);
+    u64 positions = 10'000'000; // Stop after writing at least this many positions
+    int openingPlies = 8; // Random plies at the start of each game
+    u64 seed = 0;
+};
+
+// Adjudication, using the Q of the most visited root move
+constexpr double DATAGEN_WIN_Q = 0.95; // ~730 cp
+constexpr int DATAGEN_WIN_PLIES = 4;
+constexpr double DATAGEN_DRAW_Q = 0.05; // ~20 cp
+constexpr int DATAGEN_DRAW_PLIES = 12;
+constexpr int DATAGEN_DRAW_MIN_PLY = 60;
+constexpr int DATAGEN_MAX_PLIES = 400;
+
+struct DatagenPosition {
+    Color stm;
+    std::vector<i16> activeInputs;
+    std::vector<std::pair<i16, u32>> moves4096AndVisits; // sorted by move4096
+    u16 bestMove4096;
+};
+
+inline DatagenPosition datagenPosition(Board &board, Node &root, Move bestMove)
+{
+    DatagenPosition position = DatagenPosition();
+    position.stm = board.sideToMove();
+    int stm = (int)board.sideToMove();
+
+    for (Color pieceColor : {Color::WHITE, Color::BLACK})
+        for (int pt = (int)PieceType::PAWN; pt <= (int)PieceType::KING; pt++)
+        {
+            u64 bb = board.getBitboard(pieceColor, (PieceType)pt);
+            while (bb > 0) {
+                int sq = poplsb(bb);
+                position.activeInputs.push_back(policy::INPUTS_IDXS[stm][(int)pieceColor][pt][sq]);
+            }
+        }
+
+    std::sort(position.activeInputs.begin(), position.activeInputs.end());
+
+    // Unexpanded moves have 0 visits and underpromotions aren't in the training data
+    for (int i = 0; i < root.mMoves.size(); i++)
+    {
+        PieceType promotion = root.mMoves[i].promotion();
+        if (promotion != PieceType::NONE && promotion != PieceType::QUEEN)
+            continue;
+
+        u32 visits = i < root.mChildren.size() ? root.mChildren[i].mVisits : 0;
+        position.moves4096AndVisits.push_back({ (i16)root.mMoves[i].to4096(board.sideToMove()), visits });
+    }
+
+    std::sort(position.moves4096AndVisits.begin(), position.moves4096AndVisits.end());
+
+    position.bestMove4096 = bestMove.to4096(board.sideToMove());
+    return position;
+}
+
+inline void writeDatagenPosition(std::vector<char> &buffer, DatagenPosition &position, i8 result)
+{
+    auto write = [&](auto value) {
+        const char *bytes = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+    };
+
+    write((i8)position.stm);
+    write((u8)position.activeInputs.size());
+    for (i16 activeInput : position.activeInputs)
+        write(activeInput);
+
+    write((u8)position.moves4096AndVisits.size());
+    for (auto [move4096, visits] : position.moves4096AndVisits)
+        write(move4096);
+
+    write(position.bestMove4096);
+
+    // Scale visits down if the most visited move doesn't fit in u16
+    u32 maxVisits = 0;
+    for (auto [move4096, visits] : position.moves4096AndVisits)
+        maxVisits = max(maxVisits, visits);
+
+    const u32 U16_MAX = std::numeric_limits<u16>::max();
+    for (auto [move4096, visits] : position.moves4096AndVisits)
+        write(maxVisits <= U16_MAX ? (u16)visits : (u16)((u64)visits * U16_MAX / maxVisits));
+
+    write(result);
+}
+
+inline void datagen(std::string outFileName, DatagenSettings settings = DatagenSettings())
+{
+    std::ofstream outFile(outFileName, std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) {
+        std::cout << "Error opening " << outFileName << std::endl;
+        return;
+    }
+
+    std::cout << "Generating " << settings.positions << " positions"
+              << " with " << settings.nodes << " nodes per move"
+              << ", " << settings.openingPlies << " random opening plies"
+              << " and " << settings.threads << " threads"
+              << ", writing to " << outFileName
+              << std::endl;
+
+    std::mutex outMutex;
+    std::atomic<u64> positionsWritten = 0, gamesPlayed = 0, bytesWritten = 0;
+    std::atomic<u64> whiteWins = 0, blackWins = 0, draws = 0;
+    std::chrono::steady_clock::time_point start =  std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastPrint = start;
+
+    auto worker = [&](int threadIdx) {
+        std::mt19937_64 rng(settings.seed * 1'000'003 + threadIdx);
+        Searcher searcher = Searcher(START_BOARD);
+        std::vector<Move> moves = {};
+        std::vector<DatagenPosition> positions = {};
+        std::vector<char> buffer = {};
+
+        while (positionsWritten < settings.positions)
+        {
+            Board board = START_BOARD;
+            positions.clear();
+
+            // Random opening, retried if the game ends in it
+            bool openingOk = true;
+            for (int ply = 0; ply < settings.openingPlies && openingOk; ply++)
+            {
+                board.getMoves(moves);
+                openingOk = moves.size() > 0;
+                if (openingOk)
+                    board.makeMove(moves[rng() % moves.size()]);
+            }
+
+            board.getMoves(moves);
+            if (!openingOk || moves.size() == 0) continue;
+
+            // Game result from white's perspective
+            double whiteResult = 0;
+            int winPlies = 0, lossPlies = 0, drawPlies = 0;
+
+            for (int ply = 0; ply < DATAGEN_MAX_PLIES; ply++)
+            {
+                board.getMoves(moves);
+
+                if (moves.size() == 0) {
+                    whiteResult = !board.inCheck() ? 0
+                                  : board.sideToMove() == Color::WHITE ? -1 : 1;
+                    break;
+                }
+
+                if (board.isFiftyMovesDraw() || board.isInsufficientMaterial() || board.isRepetition(true))
+                    break;
+
+                searcher.mBoard = board;
+                searcher.resetLimits();
+                searcher.mMaxNodes = settings.nodes;
+                Move bestMove = searcher.search(false);
+                auto [bestRootChild, bestRootMove] = searcher.mRoot.mostVisits();
+
+                PieceType promotion = bestMove.promotion();
+                if (promotion == PieceType::NONE || promotion == PieceType::QUEEN)
+                    positions.push_back(datagenPosition(board, searcher.mRoot, bestMove));
+
+                // Adjudicate on white's Q
+                double whiteQ = board.sideToMove() == Color::WHITE ? bestRootChild->Q() : -bestRootChild->Q();
+                winPlies = whiteQ > DATAGEN_WIN_Q ? winPlies + 1 : 0;
+                lossPlies = whiteQ < -DATAGEN_WIN_Q ? lossPlies + 1 : 0;
+                drawPlies = abs(whiteQ) < DATAGEN_DRAW_Q && ply >= DATAGEN_DRAW_MIN_PLY ? drawPlies + 1 : 0;
+
+                if (winPlies >= DATAGEN_WIN_PLIES || lossPlies >= DATAGEN_WIN_PLIES) {
+                    whiteResult = winPlies > 0 ? 1 : -1;
+                    break;
+                }
+
+                if (drawPlies >= DATAGEN_DRAW_PLIES)
+                    break;
+
+                board.makeMove(bestMove);
+            }
+
+            buffer.clear();
+            for (DatagenPosition &position : positions) {
+                double result = position.stm == Color::WHITE ? whiteResult : -whiteResult;
+                writeDatagenPosition(buffer, position, (i8)result);
+            }
+
+            std::lock_guard<std::mutex> lock(outMutex);
+            outFile.write(buffer.data(), buffer.size());
+            bytesWritten += buffer.size();
+            positionsWritten += positions.size();
+            gamesPlayed++;
+            (whiteResult > 0 ? whiteWins : whiteResult < 0 ? blackWins : draws)++;
+
+            if (millisecondsElapsed(lastPrint) >= 10'000) {
+                lastPrint = std::chrono::steady_clock::now();
+                u64 msElapsed = millisecondsElapsed(start);
+                std::cout << "positions " << positionsWritten
+                          << " games " << gamesPlayed
+                          << " positions/s " << positionsWritten * 1000 / max(msElapsed, (u64)1)
+                          << " time " << msElapsed
+                          << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < settings.threads; i++)
+        threads.emplace_back(worker, i);
+
+    worker(0);
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    outFile.close();
+
+    u64 msElapsed = millisecondsElapsed(start);
+    std::cout << "datagen positions " << positionsWritten
+              << " games " << gamesPlayed
+              << " (+" << whiteWins << " =" << draws << " -" << blackWins << ")"
+              << " bytes " << bytesWritten
+              << " positions/s " << positionsWritten * 1000 / max(msElapsed, (u64)1)
+              << " time " << msElapsed
+              << std::endl;
+}
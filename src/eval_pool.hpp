@@ -0,0 +1,207 @@
+// clang-format off
+
+#pragma once
+
+// Evaluator threads shared by all search threads (EvalThreads > 0)
+// Search threads submit leaf positions to a lock free queue and wait for their result, while evaluator threads
+// drain the queue in batches, running all value requests of a batch and then all policy requests,
+// so the hot net weights stay in the evaluators' caches instead of being pulled through every search thread's
+// A request points to the submitting thread's board, moves and policy, which don't change while it waits
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include "value_nnue.hpp"
+#include "policy.hpp"
+
+constexpr u64 EVAL_QUEUE_CAPACITY = 1024; // Power of 2, more than the max search threads
+constexpr u64 EVAL_BATCH_SIZE = 64;
+
+struct EvalRequest {
+    public:
+
+    Board *board;
+    std::vector<Move> *moves = nullptr;    // Policy request if not nullptr, else value request
+    std::vector<float> *policy = nullptr;
+    i32 eval = 0;
+
+    // 0 = pending, 1 = evaluated, 2 = released by the evaluator, which doesn't touch the request anymore
+    std::atomic<u8> state = 0;
+
+    // Blocks until an evaluator has filled eval or policy and released the request
+    inline void wait()
+    {
+        state.wait(0, std::memory_order_acquire);
+
+        while (state.load(std::memory_order_acquire) != 2)
+            std::this_thread::yield();
+    }
+};
+
+// Bounded lock free multi producer multi consumer queue (Vyukov's), each cell has a sequence number
+// that tells producers and consumers whose turn it is
+class EvalQueue {
+    private:
+
+    struct Cell {
+        std::atomic<u64> sequence;
+        EvalRequest *request;
+    };
+
+    std::unique_ptr<Cell[]> mCells;
+    alignas(64) std::atomic<u64> mEnqueuePos = 0;
+    alignas(64) std::atomic<u64> mDequeuePos = 0;
+
+    public:
+
+    inline EvalQueue() : mCells(std::make_unique<Cell[]>(EVAL_QUEUE_CAPACITY))
+    {
+        for (u64 i = 0; i < EVAL_QUEUE_CAPACITY; i++)
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    inline bool push(EvalRequest *request)
+    {
+        u64 pos = mEnqueuePos.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell &cell = mCells[pos & (EVAL_QUEUE_CAPACITY - 1)];
+            i64 diff = (i64)cell.sequence.load(std::memory_order_acquire) - (i64)pos;
+
+            if (diff == 0 && mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.request = request;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            if (diff < 0) return false; // Full
+            if (diff > 0) pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    inline bool pop(EvalRequest *&request)
+    {
+        u64 pos = mDequeuePos.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell &cell = mCells[pos & (EVAL_QUEUE_CAPACITY - 1)];
+            i64 diff = (i64)cell.sequence.load(std::memory_order_acquire) - (i64)(pos + 1);
+
+            if (diff == 0 && mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                request = cell.request;
+                cell.sequence.store(pos + EVAL_QUEUE_CAPACITY, std::memory_order_release);
+                return true;
+            }
+
+            if (diff < 0) return false; // Empty
+            if (diff > 0) pos = mDequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+class EvalPool {
+    private:
+
+    EvalQueue mQueue;
+    std::atomic<i32> mPending = 0; // Incremented before a push, so it never goes below the queue size
+    std::atomic<bool> mStop = false;
+    std::vector<std::thread> mThreads;
+
+    public:
+
+    inline EvalPool(int numThreads)
+    {
+        for (int i = 0; i < numThreads; i++)
+            mThreads.emplace_back([this]() { evaluatorLoop(); });
+    }
+
+    inline ~EvalPool()
+    {
+        mStop.store(true);
+        mPending.fetch_add(1);
+        mPending.notify_all();
+
+        for (std::thread &thread : mThreads)
+            thread.join();
+    }
+
+    inline int numThreads() { return mThreads.size(); }
+
+    // Same as value_nnue::evaluate(board.accumulator(), board.sideToMove())
+    inline i32 evaluate(Board &board)
+    {
+        EvalRequest request = EvalRequest();
+        request.board = &board;
+        submit(request);
+        return request.eval;
+    }
+
+    // Same as policy::getPolicy(policy, moves, board)
+    inline void getPolicy(std::vector<float> &policy, std::vector<Move> &moves, Board &board)
+    {
+        EvalRequest request = EvalRequest();
+        request.board = &board;
+        request.moves = &moves;
+        request.policy = &policy;
+        submit(request);
+    }
+
+    private:
+
+    inline void submit(EvalRequest &request)
+    {
+        mPending.fetch_add(1, std::memory_order_relaxed);
+
+        while (!mQueue.push(&request))
+            std::this_thread::yield();
+
+        mPending.notify_one();
+        request.wait();
+    }
+
+    inline void evaluatorLoop()
+    {
+        std::vector<EvalRequest*> batch = {};
+        batch.reserve(EVAL_BATCH_SIZE);
+
+        while (!mStop.load(std::memory_order_relaxed))
+        {
+            if (mPending.load(std::memory_order_relaxed) == 0) {
+                mPending.wait(0, std::memory_order_relaxed);
+                continue;
+            }
+
+            EvalRequest *request;
+            while (batch.size() < EVAL_BATCH_SIZE && mQueue.pop(request))
+                batch.push_back(request);
+
+            // Counted requests whose push isn't visible yet
+            if (batch.size() == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            mPending.fetch_sub(batch.size(), std::memory_order_relaxed);
+            evaluateBatch(batch);
+            batch.clear();
+        }
+    }
+
+    inline void evaluateBatch(std::vector<EvalRequest*> &batch)
+    {
+        for (EvalRequest *request : batch)
+            if (request->moves == nullptr)
+                request->eval = value_nnue::evaluate(request->board->accumulator(), request->board->sideToMove());
+
+        for (EvalRequest *request : batch)
+            if (request->moves != nullptr)
+                policy::getPolicy(*request->policy, *request->moves, *request->board);
+
+        // The request lives on its submitter's stack, so it can't be touched after it's released
+        for (EvalRequest *request : batch) {
+            request->state.store(1, std::memory_order_release);
+            request->state.notify_one();
+            request->state.store(2, std::memory_order_release);
+        }
+    }
+};
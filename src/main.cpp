@@ -18,6 +18,7 @@ int main() {
     initUtils();
     initZobrist();
     attacks::init();
+    std::cout << (attacks::isPextEnabled() ? "Using pext" : "Using magics") << std::endl;
     policy::initInputsIdxs();
     Searcher searcher = Searcher(START_BOARD);
     uci::uciLoop(searcher);
@@ -0,0 +1,167 @@
+// clang-format off
+
+// Micro benchmarks of engine primitives on the bench positions
+// Separate program from the engine, built from the repo root, e.g.
+// clang++ -std=c++20 -O3 -march=native src/microbench.cpp -o microbench
+
+#include "board.hpp"
+#include "searcher.hpp"
+#include "uci.hpp"
+
+u64 sink = 0; // Results are accumulated here so the compiler can't optimize the work away
+
+// Runs fn() once to warm up, then times it over several runs
+// Each fn() call must perform numOps operations
+template <typename F>
+inline void measure(std::string name, u64 numOps, F fn, int numRuns = 20)
+{
+    fn();
+
+    std::vector<double> nsPerOp = {};
+    for (int run = 0; run < numRuns; run++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        nsPerOp.push_back((double)(elapsed / std::chrono::nanoseconds(1)) / (double)numOps);
+    }
+
+    double mean = 0, variance = 0;
+    for (double x : nsPerOp) mean += x;
+    mean /= numRuns;
+    for (double x : nsPerOp) variance += (x - mean) * (x - mean);
+    variance /= numRuns;
+
+    std::cout << std::left << std::setw(24) << name
+              << std::right << std::setw(12) << roundToDecimalPlaces(mean, 2)
+              << std::setw(12) << roundToDecimalPlaces(sqrt(variance), 2)
+              << std::setw(12) << roundToDecimalPlaces(*std::min_element(nsPerOp.begin(), nsPerOp.end()), 2)
+              << std::setw(12) << numOps
+              << std::endl;
+}
+
+int main() {
+    initUtils();
+    initZobrist();
+    attacks::init();
+    policy::initInputsIdxs();
+
+    std::cout << "Micro benchmarks on " << FENS.size() << " positions, "
+              << (attacks::isPextEnabled() ? "using pext" : "using magics")
+              << std::endl;
+
+    std::cout << std::left << std::setw(24) << "kernel"
+              << std::right << std::setw(12) << "ns/op"
+              << std::setw(12) << "stddev"
+              << std::setw(12) << "min"
+              << std::setw(12) << "ops/run"
+              << std::endl;
+
+    std::vector<Board> boards = {};
+    std::vector<BoardState> states = {};
+    std::vector<std::vector<Move>> movesPerBoard = {};
+    u64 totalMoves = 0;
+
+    for (const std::string fen : FENS) {
+        boards.push_back(Board(fen));
+        states.push_back(BoardState(fen));
+        movesPerBoard.push_back({});
+        boards.back().getMoves(movesPerBoard.back());
+        totalMoves += movesPerBoard.back().size();
+    }
+
+    measure("fen parsing", FENS.size(), [&]() {
+        for (const std::string fen : FENS)
+            sink += BoardState(fen).zobristHash();
+    });
+
+    // getMoves() is timed on fresh copies so the cached attack maps are recomputed
+    measure("copy + getMoves", states.size(), [&]() {
+        std::vector<Move> moves = {};
+        for (BoardState &state : states) {
+            BoardState copy = state;
+            copy.getMoves(moves);
+            sink += moves.size();
+        }
+    });
+
+    measure("makeMove + undoMove", totalMoves, [&]() {
+        for (int i = 0; i < boards.size(); i++)
+            for (Move move : movesPerBoard[i]) {
+                boards[i].makeMove(move);
+                sink += boards[i].zobristHash();
+                boards[i].undoMove();
+            }
+    });
+
+    measure("inCheck (uncached)", states.size(), [&]() {
+        for (BoardState &state : states) {
+            BoardState copy = state;
+            sink += copy.inCheck();
+        }
+    });
+
+    value_nnue::Accumulator accumulator = value_nnue::Accumulator();
+    measure("activate + deactivate", 64 * 12, [&]() {
+        for (int color : {0, 1})
+            for (int pt = 0; pt < 6; pt++)
+                for (Square sq = 0; sq < 64; sq++) {
+                    accumulator.activate((Color)color, (PieceType)pt, sq);
+                    accumulator.deactivate((Color)color, (PieceType)pt, sq);
+                }
+        sink += accumulator.white[0];
+    });
+
+    measure("value_nnue::evaluate", boards.size(), [&]() {
+        for (Board &board : boards)
+            sink += value_nnue::evaluate(board.accumulator(), board.sideToMove());
+    });
+
+    measure("policy::getPolicy", boards.size(), [&]() {
+        std::vector<float> policy = {};
+        for (int i = 0; i < boards.size(); i++) {
+            policy::getPolicy(policy, movesPerBoard[i], boards[i]);
+            sink += policy[0] > 0.5;
+        }
+    });
+
+    // Synthetic trees, built by searching each position for a fixed number of nodes
+    const u64 TREE_NODES = 2000;
+    std::vector<Searcher> searchers = {};
+    searchers.reserve(FENS.size()); // Nodes point to their parent, so searchers must not move
+    for (const std::string fen : FENS) {
+        searchers.push_back(Searcher(Board(fen)));
+        searchers.back().mMaxNodes = TREE_NODES;
+        searchers.back().search(false);
+    }
+
+    measure("Node::select + revert", searchers.size(), [&]() {
+        for (Searcher &searcher : searchers) {
+            int stateIdx = (int)searcher.mBoard.numStates() - 1;
+            Node *selected = searcher.mRoot.select(searcher.mBoard);
+            sink += selected->mDepth;
+            searcher.mBoard.revertToState(stateIdx);
+        }
+    });
+
+    // Histories of up to 100 plies, playing the first legal move each ply
+    std::vector<Board> boardsWithHistory = {};
+    for (const std::string fen : FENS) {
+        boardsWithHistory.push_back(Board(fen));
+        Board &board = boardsWithHistory.back();
+        std::vector<Move> moves = {};
+
+        for (int ply = 0; ply < 100; ply++) {
+            board.getMoves(moves);
+            if (moves.size() == 0) break;
+            board.makeMove(moves[0]);
+        }
+    }
+
+    measure("isRepetition", boardsWithHistory.size(), [&]() {
+        for (Board &board : boardsWithHistory)
+            sink += board.isRepetition(true);
+    });
+
+    std::cout << "sink " << sink << std::endl;
+    return 0;
+}
@@ -0,0 +1,165 @@
+// clang-format off
+
+#pragma once
+
+// Hardware performance counters through Linux perf_event_open()
+// Counters that can't be opened (other OS, containers, perf_event_paranoid) are reported as unavailable
+
+#include "utils.hpp"
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #include <cerrno>
+    #include <cstring>
+#endif
+
+namespace perf_counters {
+
+enum Counter : int {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    COUNT
+};
+
+const std::array<std::string, COUNT> COUNTER_NAMES = {
+    "cycles", "instructions", "l1d-misses", "llc-misses", "branch-misses"
+};
+
+struct Counts {
+    std::array<u64, COUNT> values = {};
+    std::array<bool, COUNT> available = {};
+
+    inline void add(const Counts &other) {
+        for (int i = 0; i < COUNT; i++) {
+            values[i] += other.values[i];
+            available[i] = other.available[i];
+        }
+    }
+
+    // e.g. "ipc 2.31 cycles/node 5120.4 ..."
+    inline std::string toString(u64 nodes)
+    {
+        std::string str = "";
+
+        if (available[CYCLES] && available[INSTRUCTIONS])
+            str += "ipc " + roundToDecimalPlaces((double)values[INSTRUCTIONS] / max(values[CYCLES], (u64)1), 2);
+
+        for (int i = 0; i < COUNT; i++)
+            if (available[i])
+                str += (str == "" ? "" : " ") + COUNTER_NAMES[i] + "/node "
+                       + roundToDecimalPlaces((double)values[i] / max(nodes, (u64)1), 2);
+
+        return str;
+    }
+};
+
+class PerfCounters {
+    private:
+
+    std::array<int, COUNT> mFds; // -1 if the counter is unavailable
+    std::string mError = "";
+
+    public:
+
+    inline PerfCounters()
+    {
+        mFds.fill(-1);
+
+        #if defined(__linux__)
+            const std::array<std::pair<u32, u64>, COUNT> TYPES_AND_CONFIGS = {{
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                                      | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+            }};
+
+            for (int i = 0; i < COUNT; i++)
+            {
+                perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = TYPES_AND_CONFIGS[i].first;
+                attr.config = TYPES_AND_CONFIGS[i].second;
+                attr.disabled = 1;
+                attr.inherit = 1; // also count threads created while counting
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                // This thread, any cpu, no group
+                mFds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+                if (mFds[i] < 0 && mError == "")
+                    mError = std::string(strerror(errno));
+            }
+        #else
+            mError = "perf events are only supported on Linux";
+        #endif
+    }
+
+    inline ~PerfCounters()
+    {
+        #if defined(__linux__)
+            for (int fd : mFds)
+                if (fd >= 0) close(fd);
+        #endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    inline bool anyAvailable() {
+        for (int fd : mFds)
+            if (fd >= 0) return true;
+        return false;
+    }
+
+    inline std::string error() { return mError; }
+
+    inline void start()
+    {
+        #if defined(__linux__)
+            for (int fd : mFds)
+                if (fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+        #endif
+    }
+
+    inline Counts stop()
+    {
+        Counts counts = Counts();
+
+        #if defined(__linux__)
+            for (int i = 0; i < COUNT; i++)
+            {
+                if (mFds[i] < 0) continue;
+                ioctl(mFds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+                // value, time enabled, time running
+                u64 data[3] = {0, 0, 0};
+                if (read(mFds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+                    continue;
+
+                // Scale up if the kernel multiplexed this counter with others
+                counts.values[i] = data[2] < data[1]
+                                   ? (u64)((double)data[0] * (double)data[1] / (double)data[2])
+                                   : data[0];
+                counts.available[i] = true;
+            }
+        #endif
+
+        return counts;
+    }
+};
+
+} // namespace perf_counters
@@ -1,60 +1,163 @@
 #pragma once
 
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <fstream>
 #include "board.hpp"
 
-inline u64 perft(Board &board, int depth)
+// Lockless perft hash table shared by all perft threads
+// Each entry stores (zobrist hash ^ data) and data, with data = nodes << 8 | depth,
+// so a torn write from another thread is detected as a key mismatch
+class PerftTT {
+    private:
+
+    struct Entry {
+        std::atomic<u64> key, data;
+    };
+
+    std::vector<Entry> mEntries;
+
+    public:
+
+    inline PerftTT(u64 megabytes) : mEntries(megabytes * 1024 * 1024 / sizeof(Entry)) {
+        assert(mEntries.size() > 0);
+    }
+
+    inline bool probe(u64 zobristHash, int depth, u64 &nodes)
+    {
+        Entry &entry = mEntries[zobristHash % mEntries.size()];
+        u64 data = entry.data.load(std::memory_order_relaxed);
+        u64 key = entry.key.load(std::memory_order_relaxed);
+
+        if ((key ^ data) != zobristHash || (data & 0xFF) != (u64)depth)
+            return false;
+
+        nodes = data >> 8;
+        return true;
+    }
+
+    inline void store(u64 zobristHash, int depth, u64 nodes)
+    {
+        Entry &entry = mEntries[zobristHash % mEntries.size()];
+        u64 data = (nodes << 8) | (u64)depth;
+        entry.key.store(zobristHash ^ data, std::memory_order_relaxed);
+        entry.data.store(data, std::memory_order_relaxed);
+    }
+};
+
+inline u64 perft(Board &board, int depth, PerftTT *tt = nullptr)
 {
     if (depth == 0) return 1;
 
+    // Probe before generating moves, so hits skip the movegen
+    u64 nodes = 0;
+    if (depth >= 2 && tt != nullptr && tt->probe(board.zobristHash(), depth, nodes))
+        return nodes;
+
     std::vector<Move> moves = {};
     board.getMoves(moves);
 
     if (depth == 1) return moves.size();
 
-    u64 nodes = 0;
-    for (int i = 0; i < moves.size(); i++) 
+    for (int i = 0; i < moves.size(); i++)
     {
         board.makeMove(moves[i]);
-        nodes += perft(board, depth - 1);
+        nodes += perft(board, depth - 1, tt);
         board.undoMove();
     }
 
+    if (tt != nullptr)
+        tt->store(board.zobristHash(), depth, nodes);
+
+    return nodes;
+}
+
+struct PerftSettings {
+    int threads = max((int)std::thread::hardware_concurrency(), 1);
+    u64 hashMegabytes = 64;
+};
+
+// Splits the root moves across threads, each with its own copy of the board,
+// and returns the nodes of each root move
+inline std::vector<u64> perftRootMoves(Board &board, int depth, std::vector<Move> &moves,
+                                       PerftSettings settings)
+{
+    assert(depth >= 1);
+    board.getMoves(moves);
+    std::vector<u64> nodes(moves.size(), 1);
+
+    if (depth == 1) return nodes;
+
+    PerftTT tt = PerftTT(settings.hashMegabytes);
+    std::atomic<int> nextMoveIdx = 0;
+
+    auto worker = [&]() {
+        Board threadBoard = board;
+        int i;
+        while ((i = nextMoveIdx.fetch_add(1)) < (int)moves.size()) {
+            threadBoard.makeMove(moves[i]);
+            nodes[i] = perft(threadBoard, depth - 1, &tt);
+            threadBoard.undoMove();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < min(settings.threads, (int)moves.size()); i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread &thread : threads)
+        thread.join();
+
     return nodes;
 }
 
-inline void perftSplit(Board &board, int depth)
+inline void perftSplit(Board &board, int depth, PerftSettings settings = PerftSettings())
 {
-    std::cout << "Running split perft depth " << depth 
+    std::cout << "Running split perft depth " << depth
               << " on " << board.fen() << std::endl;
 
+    std::chrono::steady_clock::time_point start =  std::chrono::steady_clock::now();
     std::vector<Move> moves = {};
-    board.getMoves(moves);
+    std::vector<u64> nodes = perftRootMoves(board, depth, moves, settings);
     u64 totalNodes = 0;
 
-    for (int i = 0; i < moves.size(); i++) 
+    for (int i = 0; i < moves.size(); i++)
     {
-        Move move = moves[i];
-        board.makeMove(move);
-        u64 nodes = perft(board, depth - 1);
-        board.undoMove();
-        std::cout << move.toUci() << ": " << nodes << std::endl;
-        totalNodes += nodes;
+        std::cout << moves[i].toUci() << ": " << nodes[i] << std::endl;
+        totalNodes += nodes[i];
     }
 
     std::cout << "Total: " << totalNodes << std::endl;
+    std::cout << "nps " << totalNodes * 1000 / max((u64)millisecondsElapsed(start), (u64)1)
+              << " time " << millisecondsElapsed(start)
+              << std::endl;
 }
 
-inline u64 perftBench(Board &board, int depth)
+inline u64 perftBench(Board &board, int depth, PerftSettings settings = PerftSettings())
 {
-    std::cout << "Running perft depth " << depth 
-              << " on " << board.fen() << std::endl;
+    std::cout << "Running perft depth " << depth
+              << " on " << board.fen()
+              << " with " << settings.threads << " threads"
+              << " and " << settings.hashMegabytes << " MB hash"
+              << std::endl;
 
     std::chrono::steady_clock::time_point start =  std::chrono::steady_clock::now();
-    u64 nodes = perft(board, depth);
+    u64 nodes = 0;
+
+    if (depth == 0)
+        nodes = 1;
+    else {
+        std::vector<Move> moves = {};
+        for (u64 moveNodes : perftRootMoves(board, depth, moves, settings))
+            nodes += moveNodes;
+    }
 
-    std::cout << "perft depth " << depth 
-              << " nodes " << nodes 
+    std::cout << "perft depth " << depth
+              << " nodes " << nodes
               << " nps " << nodes * 1000 / max((u64)millisecondsElapsed(start), (u64)1)
               << " time " << millisecondsElapsed(start)
               << " fen " << board.fen()
@@ -62,3 +165,112 @@ inline u64 perftBench(Board &board, int depth)
 
     return nodes;
 }
+
+struct PerftSuiteEntry {
+    std::string fen;
+    std::vector<std::pair<int, u64>> expected; // [(depth, nodes)]
+};
+
+// Runs every entry of an EPD file with lines like "<fen> ;D1 20 ;D2 400 ;D3 8902"
+// Entries run in parallel, one per thread, and the suite stops at the first mismatch
+inline bool perftSuite(std::string fileName, PerftSettings settings = PerftSettings())
+{
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+        std::cout << "Error opening " << fileName << std::endl;
+        return false;
+    }
+
+    std::vector<PerftSuiteEntry> entries = {};
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> tokens = splitString(line, ';');
+        if (tokens.size() < 2) continue;
+
+        PerftSuiteEntry entry = { tokens[0], {} };
+        for (int i = 1; i < tokens.size(); i++) {
+            std::vector<std::string> depthAndNodes = splitString(tokens[i], ' ');
+            if (depthAndNodes.size() != 2 || depthAndNodes[0][0] != 'D') continue;
+            int depth = stoi(depthAndNodes[0].substr(1));
+            entry.expected.push_back({ depth, std::stoull(depthAndNodes[1]) });
+        }
+
+        entries.push_back(entry);
+    }
+
+    std::cout << "Running perft suite " << fileName
+              << " with " << entries.size() << " positions"
+              << ", " << settings.threads << " threads"
+              << " and " << settings.hashMegabytes << " MB hash"
+              << std::endl;
+
+    std::chrono::steady_clock::time_point start =  std::chrono::steady_clock::now();
+    PerftTT tt = PerftTT(settings.hashMegabytes);
+    std::atomic<int> nextEntryIdx = 0, passed = 0;
+    std::atomic<u64> totalNodes = 0;
+    std::atomic<bool> failed = false;
+    std::mutex printMutex;
+
+    auto worker = [&]() {
+        int i;
+        while (!failed && (i = nextEntryIdx.fetch_add(1)) < (int)entries.size())
+        {
+            std::chrono::steady_clock::time_point entryStart =  std::chrono::steady_clock::now();
+            Board board = Board(entries[i].fen);
+            u64 entryNodes = 0;
+            bool ok = true;
+
+            for (auto [depth, expectedNodes] : entries[i].expected)
+            {
+                u64 nodes = perft(board, depth, &tt);
+                entryNodes += nodes;
+
+                if (nodes != expectedNodes) {
+                    failed = true;
+                    ok = false;
+                    std::lock_guard<std::mutex> lock(printMutex);
+                    std::cout << "Mismatch in position " << i + 1
+                              << " depth " << depth
+                              << " expected " << expectedNodes
+                              << " got " << nodes
+                              << " fen " << entries[i].fen
+                              << std::endl;
+                    break;
+                }
+            }
+
+            totalNodes += entryNodes;
+            if (!ok) break;
+            passed++;
+
+            u64 msElapsed = millisecondsElapsed(entryStart);
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << "position " << i + 1 << "/" << entries.size()
+                      << " nodes " << entryNodes
+                      << " nps " << entryNodes * 1000 / max(msElapsed, (u64)1)
+                      << " time " << msElapsed
+                      << " fen " << entries[i].fen
+                      << std::endl;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < settings.threads; i++)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    u64 msElapsed = millisecondsElapsed(start);
+    std::cout << "perftsuite " << (failed ? "failed" : "passed")
+              << " positions " << passed << "/" << entries.size()
+              << " nodes " << totalNodes
+              << " nps " << totalNodes * 1000 / max(msElapsed, (u64)1)
+              << " time " << msElapsed
+              << std::endl;
+
+    return !failed;
+}
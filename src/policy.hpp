@@ -12,15 +12,56 @@
 namespace policy {
 
 constexpr i32 INPUT_SIZE = 768, 
-              HIDDEN_SIZE = 32,
-              OUTPUT_SIZE = 4096;
+              HIDDEN_SIZE = 32;
+
+// Build with -DPOLICY_SHARED_TRUNK for a policy net without its own first layer, whose hidden layer is
+// the first HIDDEN_SIZE neurons of the side to move's value accumulator, clipped to [0, QA] and scaled to [0, 1]
+// The accumulator is already updated incrementally by makeMove(), so expanding a node only computes the outputs
+// The net (weights2 and outputBiases only) is trained against the embedded value net, see trainer/train.cpp
+#if defined(POLICY_SHARED_TRUNK)
+    static_assert(HIDDEN_SIZE <= value_nnue::HIDDEN_LAYER_SIZE);
+#endif
+
+// Build with -DPOLICY_COMPACT for the compact output layer, with 1 output per from-to pair that a queen
+// or a knight can make on an empty board, instead of all 4096 pairs
+// Those are all the moves the net predicts, since underpromotions use the queen promotion's output
+#if defined(POLICY_COMPACT)
+    constexpr i32 OUTPUT_SIZE = 1792;
+#else
+    constexpr i32 OUTPUT_SIZE = 4096;
+#endif
+
+// [move4096] -> output neuron index, -1 if no piece can make the move
+constexpr std::array<i16, 4096> OUTPUT_IDXS = []() {
+    std::array<i16, 4096> outputIdxs = {};
+    i16 numOutputs = 0;
+
+    for (int from = 0; from < 64; from++)
+        for (int to = 0; to < 64; to++) {
+            int fileDiff = std::max(from % 8, to % 8) - std::min(from % 8, to % 8);
+            int rankDiff = std::max(from / 8, to / 8) - std::min(from / 8, to / 8);
+
+            bool isQueenOrKnightMove = from != to
+                                       && (fileDiff == 0 || rankDiff == 0 || fileDiff == rankDiff || fileDiff * rankDiff == 2);
+
+            outputIdxs[from * 64 + to] = OUTPUT_SIZE == 4096 ? from * 64 + to
+                                         : isQueenOrKnightMove ? numOutputs++ : -1;
+        }
+
+    return outputIdxs;
+}();
+
+// h8g8 is the last queen or knight move
+static_assert(OUTPUT_SIZE == 4096 || OUTPUT_IDXS[63 * 64 + 62] == OUTPUT_SIZE - 1);
 
 struct alignas(64) Net {
-    // [inputIdx][hiddenNeuronIdx]
-    std::array<std::array<float, HIDDEN_SIZE>, INPUT_SIZE> weights1;
+    #if !defined(POLICY_SHARED_TRUNK)
+        // [inputIdx][hiddenNeuronIdx]
+        std::array<std::array<float, HIDDEN_SIZE>, INPUT_SIZE> weights1;
 
-    // [hiddenNeuronIdx]
-    std::array<float, HIDDEN_SIZE> hiddenBiases;
+        // [hiddenNeuronIdx]
+        std::array<float, HIDDEN_SIZE> hiddenBiases;
+    #endif
 
     // [outputNeuronIdx][hiddenNeuronIdx]
     std::array<std::array<float, HIDDEN_SIZE>, OUTPUT_SIZE> weights2;
@@ -29,7 +70,15 @@ struct alignas(64) Net {
     std::array<float, OUTPUT_SIZE> outputBiases; 
 };
 
-INCBIN(PolicyNetFile, "src-test/policy_net.bin");
+#if defined(POLICY_SHARED_TRUNK) && defined(POLICY_COMPACT)
+    INCBIN(PolicyNetFile, "src-test/policy_net_shared_trunk_compact.bin");
+#elif defined(POLICY_SHARED_TRUNK)
+    INCBIN(PolicyNetFile, "src-test/policy_net_shared_trunk.bin");
+#elif defined(POLICY_COMPACT)
+    INCBIN(PolicyNetFile, "src-test/policy_net_compact.bin");
+#else
+    INCBIN(PolicyNetFile, "src-test/policy_net.bin");
+#endif
 const Net *NET = reinterpret_cast<const Net*>(gPolicyNetFileData);
 
 int INPUTS_IDXS[2][2][6][64]; // [stm][pieceColor][pieceType][square]
@@ -48,6 +97,7 @@ constexpr void initInputsIdxs() {
             }
 }
 
+#if !defined(POLICY_SHARED_TRUNK)
 inline void addWeights(std::array<float, HIDDEN_SIZE> &hiddenLayer,
                        Board &board, Color pieceColor, PieceType pt)
 {
@@ -61,6 +111,7 @@ inline void addWeights(std::array<float, HIDDEN_SIZE> &hiddenLayer,
             hiddenLayer[i] += NET->weights1[inputIdx][i];
     }
 }
+#endif
 
 inline void getPolicy(std::vector<float> &policy, std::vector<Move> &moves, Board &board)
 {
@@ -73,28 +124,40 @@ inline void getPolicy(std::vector<float> &policy, std::vector<Move> &moves, Boar
         return;
     }
 
-    // Initialize hidden layer with biases
     std::array<float, HIDDEN_SIZE> hiddenLayer;
-    for (int i = 0; i < HIDDEN_SIZE; i++)
-        hiddenLayer[i] = NET->hiddenBiases[i];
 
-    // Add the weights of the board pieces to the hidden layer
-    for (Color pieceColor : {Color::WHITE, Color::BLACK})
-        for (int pt = (int)PieceType::PAWN; pt <= (int)PieceType::KING; pt++)
-            addWeights(hiddenLayer, board, pieceColor, (PieceType)pt);
+    #if defined(POLICY_SHARED_TRUNK)
+        // Hidden layer is a slice of the value accumulator, clipped and dequantized
+        value_nnue::Accumulator &accumulator = board.accumulator();
+        auto &stmAccumulator = board.sideToMove() == Color::WHITE ? accumulator.white : accumulator.black;
 
-    // ReLU the hidden layer
-    for (int i = 0; i < HIDDEN_SIZE; i++)
-        hiddenLayer[i] = max((float)0, hiddenLayer[i]);
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+            hiddenLayer[i] = (float)std::clamp<i32>(stmAccumulator[i], 0, value_nnue::QA) / (float)value_nnue::QA;
+    #else
+        // Initialize hidden layer with biases
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+            hiddenLayer[i] = NET->hiddenBiases[i];
+
+        // Add the weights of the board pieces to the hidden layer
+        for (Color pieceColor : {Color::WHITE, Color::BLACK})
+            for (int pt = (int)PieceType::PAWN; pt <= (int)PieceType::KING; pt++)
+                addWeights(hiddenLayer, board, pieceColor, (PieceType)pt);
+
+        // ReLU the hidden layer
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+            hiddenLayer[i] = max((float)0, hiddenLayer[i]);
+    #endif
 
     float total = 0.0;
     for (int i = 0; i < moves.size(); i++)
     {
         // Calculate the output neuron corresponding to this move
-        auto move4096 = moves[i].to4096(board.sideToMove());
-        policy[i] = NET->outputBiases[move4096];
+        int outputIdx = OUTPUT_IDXS[moves[i].to4096(board.sideToMove())];
+        assert(outputIdx >= 0);
+
+        policy[i] = NET->outputBiases[outputIdx];
         for (int j = 0; j < HIDDEN_SIZE; j++)
-            policy[i] += hiddenLayer[j] * NET->weights2[move4096][j];
+            policy[i] += hiddenLayer[j] * NET->weights2[outputIdx][j];
 
         // Softmax part 1
         policy[i] = exp(policy[i]); // e^policy[i]
@@ -0,0 +1,151 @@
+// clang-format off
+
+#pragma once
+
+// Hot path profiling, enabled by compiling with -DPROFILE
+// Without PROFILE, timers are empty and compile to nothing
+
+#include "utils.hpp"
+
+#if defined(PROFILE) && (defined(__x86_64__) || defined(__i386__))
+    #include <x86intrin.h>
+    #define PROFILE_RDTSC
+#endif
+
+namespace profile {
+
+enum class Phase : int {
+    SELECT,    // Node::select(), including the makeMove() replay
+    MAKE_MOVE, // makeMove() replay in Node::select()
+    EXPAND,    // Node::expand(), including move generation and policy
+    MOVEGEN,   // getMoves() and game state in the Node constructor
+    POLICY,    // policy::getPolicy()
+    VALUE,     // Node::simulate(), i.e. value net inference
+    BACKPROP,  // Node::backprop()
+    REVERT,    // Board::revertToState()
+    COUNT
+};
+
+const std::array<std::string, (int)Phase::COUNT> PHASE_NAMES = {
+    "select", "  makemove", "expand", "  movegen", "  policy", "value", "backprop", "revert"
+};
+
+struct Stats {
+    std::array<u64, (int)Phase::COUNT> ticks = {}, calls = {};
+    u64 searchTicks = 0, playouts = 0, milliseconds = 0; // Summed over search threads when merged
+
+    inline void reset() { *this = Stats(); }
+
+    inline void add(const Stats &other) {
+        for (int i = 0; i < (int)Phase::COUNT; i++) {
+            ticks[i] += other.ticks[i];
+            calls[i] += other.calls[i];
+        }
+        searchTicks += other.searchTicks;
+        playouts += other.playouts;
+        milliseconds += other.milliseconds;
+    }
+};
+
+thread_local Stats stats; // Stats of this thread's current or last search
+
+constexpr bool isEnabled() {
+    #if defined(PROFILE)
+        return true;
+    #else
+        return false;
+    #endif
+}
+
+inline u64 ticks()
+{
+    #if defined(PROFILE_RDTSC)
+        return __rdtsc();
+    #else
+        return std::chrono::steady_clock::now().time_since_epoch() / std::chrono::nanoseconds(1);
+    #endif
+}
+
+// Times sequential phases, each lap() ends the current phase and starts the next
+struct Timer {
+    #if defined(PROFILE)
+        u64 mLast = ticks();
+
+        inline void lap(Phase phase) {
+            u64 now = ticks();
+            stats.ticks[(int)phase] += now - mLast;
+            stats.calls[(int)phase]++;
+            mLast = now;
+        }
+    #else
+        inline void lap(Phase) { }
+    #endif
+};
+
+// Times a phase nested in another phase, until it goes out of scope
+struct ScopedTimer {
+    #if defined(PROFILE)
+        Phase mPhase;
+        u64 mStart;
+
+        inline ScopedTimer(Phase phase) : mPhase(phase), mStart(ticks()) { }
+
+        inline ~ScopedTimer() {
+            stats.ticks[(int)mPhase] += ticks() - mStart;
+            stats.calls[(int)mPhase]++;
+        }
+    #else
+        // Non trivial, so unused timers aren't warned about
+        inline ScopedTimer(Phase) { }
+        inline ~ScopedTimer() { }
+    #endif
+};
+
+inline void print(const Stats &stats)
+{
+    if (!isEnabled()) {
+        std::cout << "Profiling is disabled, compile with -DPROFILE to enable it" << std::endl;
+        return;
+    }
+
+    if (stats.playouts == 0 || stats.searchTicks == 0) {
+        std::cout << "No search profiled yet" << std::endl;
+        return;
+    }
+
+    // Convert ticks to nanoseconds using the wall time of the profiled searches
+    double nsPerTick = (double)stats.milliseconds * 1'000'000.0 / (double)stats.searchTicks;
+    u64 phasesTicks = 0;
+
+    std::cout << "profile playouts " << stats.playouts
+              << " time " << stats.milliseconds
+              << std::endl;
+
+    std::cout << std::left << std::setw(12) << "phase"
+              << std::right << std::setw(14) << "calls"
+              << std::setw(10) << "search%"
+              << std::setw(14) << "ns/playout"
+              << std::setw(12) << "ns/call"
+              << std::endl;
+
+    auto printRow = [&](std::string name, u64 ticks, u64 calls) {
+        std::cout << std::left << std::setw(12) << name
+                  << std::right << std::setw(14) << calls
+                  << std::setw(10) << roundToDecimalPlaces(100.0 * ticks / stats.searchTicks, 2)
+                  << std::setw(14) << roundToDecimalPlaces(ticks * nsPerTick / stats.playouts, 1)
+                  << std::setw(12) << roundToDecimalPlaces(ticks * nsPerTick / max(calls, (u64)1), 1)
+                  << std::endl;
+    };
+
+    for (int i = 0; i < (int)Phase::COUNT; i++) {
+        printRow(PHASE_NAMES[i], stats.ticks[i], stats.calls[i]);
+
+        // Nested phases are already included in their parent
+        if (PHASE_NAMES[i][0] != ' ')
+            phasesTicks += stats.ticks[i];
+    }
+
+    printRow("other", stats.searchTicks - min(phasesTicks, stats.searchTicks), stats.playouts);
+}
+
+} // namespace profile
@@ -1,5 +1,60 @@
+#include <thread>
+#include <mutex>
+#include <memory>
+#include "profile.hpp"
 #include "tree_node.hpp"
 
+// Root parallel search (Threads > 1): each helper thread searches its own tree of the same root with its own
+// board copy and Dirichlet noise on its root policy, so search threads share no tree or board
+// Helpers publish their root stats every ROOT_SYNC_PLAYOUTS playouts, which are merged with the main tree's
+// for info lines, and the final root stats of all trees are merged to pick the best move
+constexpr double ROOT_NOISE_ALPHA = 0.3, ROOT_NOISE_EPSILON = 0.25;
+constexpr u64 ROOT_SYNC_PLAYOUTS = 1024;
+
+struct RootMoveStats {
+    Move move;
+    u64 visits = 0;
+    double resultsSum = 0;
+    bool isMate = false; // The child is lost for its side to move
+
+    inline double Q() {
+        assert(visits > 0);
+        return resultsSum / (double)visits;
+    }
+};
+
+// Adds the stats of a root move to the stats of the same move, appending it if it isn't there
+inline void addRootMoveStats(std::vector<RootMoveStats> &stats, RootMoveStats moveStats)
+{
+    auto it = std::find_if(stats.begin(), stats.end(),
+        [&](const RootMoveStats &other) { return other.move == moveStats.move; });
+
+    if (it == stats.end()) {
+        stats.push_back(moveStats);
+        return;
+    }
+
+    it->visits += moveStats.visits;
+    it->resultsSum += moveStats.resultsSum;
+    it->isMate |= moveStats.isMate;
+}
+
+// Adds the stats of the expanded children of a root, in children order
+inline void addRootStats(std::vector<RootMoveStats> &stats, Node &root)
+{
+    for (int i = 0; i < root.mChildren.size(); i++) {
+        Node &child = root.mChildren[i];
+        addRootMoveStats(stats, { root.mMoves[i], child.mVisits, child.mResultsSum, child.mGameState == GameState::LOST });
+    }
+}
+
+// Root stats last published by a helper, the only data a helper shares while searching
+struct RootSnapshot {
+    std::mutex mutex;
+    std::vector<RootMoveStats> stats = {};
+    u64 nodes = 0;
+};
+
 class Searcher {
     public:
 
@@ -7,12 +62,38 @@ class Searcher {
     Node mRoot;
     std::chrono::time_point<std::chrono::steady_clock> mStartTime;
     u64 mMilliseconds, mNodes, mMaxNodes;
+    u16 mSelDepth = 0; // Deepest node reached in the current search
+    int mMultiPV = 1;
+    int mThreads = 1; // Root parallel trees, searched by this thread and mThreads - 1 helpers
+
+    // Evaluator threads running the nets for this searcher and its helpers, none = nets run inline
+    std::shared_ptr<EvalPool> mEvalPool = nullptr;
+
+    // Helpers of the last search, kept until the next one so its merged root stats can be read
+    // from their snapshots, their trees are released when it ends
+    std::vector<std::unique_ptr<Searcher>> mHelpers = {};
+
+    // Bytes of all trees at the end of the last search, recorded only if mRecordTreeBytes since it walks them
+    bool mRecordTreeBytes = false;
+    u64 mTreeBytes = 0;
+
+    // Profile stats of the last search merged over all trees, since profile::stats only has this thread's
+    profile::Stats mProfileStats = profile::Stats();
+
+    // Set on helpers only
+    std::unique_ptr<RootSnapshot> mSnapshot = nullptr;
+    bool mRootNoise = false;
+    u64 mRootNoiseSeed = 0;
 
     inline Searcher(Board board) {
         resetLimits();
         mBoard = board;
     }
 
+    inline void setEvalThreads(int evalThreads) {
+        mEvalPool = evalThreads > 0 ? std::make_shared<EvalPool>(evalThreads) : nullptr;
+    }
+
     inline void resetLimits() {
         mStartTime = std::chrono::steady_clock::now();
         mNodes =  0;
@@ -34,45 +115,247 @@ class Searcher {
     }
 
     inline Move search(bool boolPrintInfo, u64 maxAvgDepth = U64_MAX) {
+        profile::stats.reset();
+        u64 searchStartTicks = profile::ticks();
+
         mRoot = Node(mBoard, nullptr, 0);
         mNodes = 1;
+        mSelDepth = 0;
         int boardStateIdx = (int)mBoard.numStates() - 1;
         u64 depthSum = 0;
         u64 printInfoDepth = 1;
 
+        if (mRootNoise) addRootNoise();
+
+        u64 maxNodes = mMaxNodes;
+        std::vector<std::thread> helperThreads = startHelpers(maxAvgDepth);
+
         while (!isTimeUp() && depthSum / mNodes < maxAvgDepth) {
+            profile::Timer timer = profile::Timer();
+
             Node *selected = mRoot.select(mBoard);
+            timer.lap(profile::Phase::SELECT);
 
-            Node *node = selected->mGameState != GameState::ONGOING
-                         ? selected : selected->expand(mBoard);
+            Node *node = selected;
+            if (selected->mGameState == GameState::ONGOING) {
+                node = selected->expand(mBoard, mEvalPool.get());
+                timer.lap(profile::Phase::EXPAND);
+            }
+
+            double wdl = node->simulate(mBoard, mEvalPool.get());
+            timer.lap(profile::Phase::VALUE);
+
+            node->backprop(wdl);
+            timer.lap(profile::Phase::BACKPROP);
 
-            node->backprop(node->simulate(mBoard));
             mBoard.revertToState(boardStateIdx);
+            timer.lap(profile::Phase::REVERT);
 
             mNodes++;
             depthSum += node->mDepth;
+            mSelDepth = max(mSelDepth, node->mDepth);
             if (depthSum / mNodes == printInfoDepth && boolPrintInfo)
                 printInfo(printInfoDepth++);
+
+            if (mSnapshot != nullptr && mNodes % ROOT_SYNC_PLAYOUTS == 0)
+                publishSnapshot();
         }
 
+        for (std::thread &thread : helperThreads)
+            thread.join();
+
+        mMaxNodes = maxNodes;
+
+        if (mRecordTreeBytes) {
+            mTreeBytes = mRoot.memoryBytes();
+            for (std::unique_ptr<Searcher> &helper : mHelpers)
+                mTreeBytes += helper->mRoot.memoryBytes();
+        }
+
+        // Helpers published their final stats before returning
+        for (std::unique_ptr<Searcher> &helper : mHelpers) {
+            helper->mRoot = Node();
+            helper->mEvalPool = nullptr;
+        }
+
+        if (mSnapshot != nullptr)
+            publishSnapshot();
+
+        profile::stats.searchTicks = profile::ticks() - searchStartTicks;
+        profile::stats.playouts = mNodes - 1;
+        profile::stats.milliseconds = millisecondsElapsed(mStartTime);
+
+        // Helpers set theirs before returning
+        mProfileStats = profile::stats;
+        for (std::unique_ptr<Searcher> &helper : mHelpers)
+            mProfileStats.add(helper->mProfileStats);
+
         if (boolPrintInfo)
             printInfo(round((double)depthSum / (double)mNodes));
 
-        auto [bestRootChild, bestRootMove] = mRoot.mostVisits();
-        return bestRootMove;
+        return bestRootMove().move;
+    }
+
+    // Root moves stats merged over all trees, in the main tree's children order and then the order
+    // the helpers add moves, with the latest published stats of the helpers during a search
+    inline std::vector<RootMoveStats> rootStats()
+    {
+        std::vector<RootMoveStats> stats = {};
+        addRootStats(stats, mRoot);
+
+        for (std::unique_ptr<Searcher> &helper : mHelpers) {
+            std::lock_guard<std::mutex> lock(helper->mSnapshot->mutex);
+            for (RootMoveStats &moveStats : helper->mSnapshot->stats)
+                addRootMoveStats(stats, moveStats);
+        }
+
+        return stats;
     }
 
+    // Most visited root move over all trees, ties broken by rootStats() order like in Node::mostVisits()
+    inline RootMoveStats bestRootMove()
+    {
+        std::vector<RootMoveStats> stats = rootStats();
+        assert(stats.size() > 0);
+
+        return *std::max_element(stats.begin(), stats.end(),
+            [](const RootMoveStats &a, const RootMoveStats &b) { return a.visits < b.visits; });
+    }
+
+    // Nodes of all trees, with the latest published nodes of the helpers during a search
+    inline u64 totalNodes()
+    {
+        u64 nodes = mNodes;
+
+        for (std::unique_ptr<Searcher> &helper : mHelpers) {
+            std::lock_guard<std::mutex> lock(helper->mSnapshot->mutex);
+            nodes += helper->mSnapshot->nodes;
+        }
+
+        return nodes;
+    }
+
+    // Score of a root child from the root side to move's perspective, e.g. "cp 35" or "mate 1"
+    // cp inverts the eval to wdl mapping of Node::simulate()
+    inline static std::string uciScore(double Q, bool isMate)
+    {
+        if (isMate) return "mate 1";
+
+        Q = std::clamp(Q, -0.9999, 0.9999);
+        return "cp " + std::to_string((int)round(200.0 * log((1.0 + Q) / (1.0 - Q))));
+    }
+
+    inline static std::string uciScore(Node &rootChild) {
+        return uciScore(rootChild.Q(), rootChild.mGameState == GameState::LOST);
+    }
+
+    // One line per root move, for the mMultiPV most visited root moves, with stats merged over all trees
+    // Only the root moves are sorted and each PV follows the most visited children of the main tree,
+    // so this doesn't walk the tree
     inline void printInfo(u64 avgDepth)
     {
-        auto [bestRootChild, bestRootMove] = mRoot.mostVisits();
         u64 msElapsed = millisecondsElapsed(mStartTime);
+        u64 nodes = totalNodes();
+        std::vector<RootMoveStats> stats = rootStats();
+        int numLines = min(mMultiPV, (int)stats.size());
+
+        // Ties are broken by rootStats() order, like in Node::mostVisits()
+        std::stable_sort(stats.begin(), stats.end(),
+            [](const RootMoveStats &a, const RootMoveStats &b) { return a.visits > b.visits; });
+
+        std::vector<Move> pv = {};
+
+        for (int line = 0; line < numLines; line++)
+        {
+            RootMoveStats &moveStats = stats[line];
+
+            // Helper only moves have no PV in the main tree
+            pv.clear();
+            for (int i = 0; i < mRoot.mChildren.size(); i++)
+                if (mRoot.mMoves[i] == moveStats.move)
+                    mRoot.mChildren[i].pv(pv);
+
+            std::cout << "info depth " << avgDepth
+                      << " seldepth " << mSelDepth
+                      << " multipv " << line + 1
+                      << " score " << uciScore(moveStats.Q(), moveStats.isMate)
+                      << " nodes " << nodes
+                      << " time " << msElapsed
+                      << " nps " << nodes * 1000 / max(msElapsed, (u64)1)
+                      << " pv " << moveStats.move.toUci();
+
+            for (Move move : pv)
+                std::cout << " " << move.toUci();
+
+            std::cout << std::endl;
+        }
+    }
+
+    private:
+
+    // Starts mThreads - 1 helpers on copies of the root, with the same time limit and
+    // the node limit split evenly between all trees, including this one's for the rest of the search
+    inline std::vector<std::thread> startHelpers(u64 maxAvgDepth)
+    {
+        mHelpers.clear();
+        std::vector<std::thread> helperThreads = {};
+
+        if (mThreads <= 1) return helperThreads;
+
+        u64 maxNodes = mMaxNodes;
+        if (maxNodes != U64_MAX)
+            mMaxNodes = max(maxNodes / mThreads + (maxNodes % mThreads > 0), (u64)1);
+
+        for (int i = 1; i < mThreads; i++)
+        {
+            std::unique_ptr<Searcher> helper = std::make_unique<Searcher>(mBoard);
+            helper->mStartTime = mStartTime;
+            helper->mMilliseconds = mMilliseconds;
+            helper->mEvalPool = mEvalPool;
+            helper->mMaxNodes = maxNodes == U64_MAX ? U64_MAX
+                                : max(maxNodes / mThreads + (maxNodes % mThreads > (u64)i), (u64)1);
+            helper->mSnapshot = std::make_unique<RootSnapshot>();
+            helper->mRootNoise = true;
+            helper->mRootNoiseSeed = mBoard.zobristHash() ^ (u64)i * 0x9E3779B97F4A7C15ULL;
+            mHelpers.push_back(std::move(helper));
+        }
+
+        for (std::unique_ptr<Searcher> &helper : mHelpers)
+            helperThreads.emplace_back([&helper, maxAvgDepth]() { helper->search(false, maxAvgDepth); });
+
+        return helperThreads;
+    }
+
+    // Mixes Dirichlet noise into the root policy, computing it first since expand() hasn't yet
+    inline void addRootNoise()
+    {
+        if (mRoot.mPolicy.size() == 0) {
+            profile::ScopedTimer timer = profile::ScopedTimer(profile::Phase::POLICY);
+            policy::getPolicy(mRoot.mPolicy, mRoot.mMoves, mBoard);
+        }
+
+        std::mt19937_64 rng(mRootNoiseSeed);
+        std::gamma_distribution<double> gamma(ROOT_NOISE_ALPHA, 1.0);
+        std::vector<double> noise(mRoot.mPolicy.size());
+        double noiseSum = 0;
+
+        for (double &sample : noise) {
+            sample = gamma(rng);
+            noiseSum += sample;
+        }
+
+        for (int i = 0; i < mRoot.mPolicy.size(); i++)
+            mRoot.mPolicy[i] = (1.0 - ROOT_NOISE_EPSILON) * mRoot.mPolicy[i]
+                               + ROOT_NOISE_EPSILON * noise[i] / max(noiseSum, 1e-9);
+    }
+
+    inline void publishSnapshot()
+    {
+        std::vector<RootMoveStats> stats = {};
+        addRootStats(stats, mRoot);
 
-        std::cout << "info depth " << avgDepth
-                  << " nodes " << mNodes
-                  << " time " << msElapsed
-                  << " nps " << mNodes * 1000 / max(msElapsed, (u64)1)
-                  << " wdl " << roundToDecimalPlaces(bestRootChild->Q(), 2)
-                  << " pv " << bestRootMove.toUci()
-                  << std::endl;
+        std::lock_guard<std::mutex> lock(mSnapshot->mutex);
+        mSnapshot->stats = std::move(stats);
+        mSnapshot->nodes = mNodes;
     }
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "value_nnue.hpp"
 #include "policy.hpp"
+#include "eval_pool.hpp"
+#include "profile.hpp"
 
 const double PUCT_C = 2; // Higher => more exploration
 
@@ -19,6 +21,7 @@ struct Node {
     inline Node(Board &board, Node *parent, u16 depth) {
         mParent = parent;
         mChildren = {};
+        profile::ScopedTimer timer = profile::ScopedTimer(profile::Phase::MOVEGEN);
         board.getMoves(mMoves);
         mPolicy = {};
         mVisits = mResultsSum = 0;
@@ -77,17 +80,27 @@ struct Node {
             }
         }
 
-        board.makeMove(mMoves[bestChildIdx]);
+        {
+            profile::ScopedTimer timer = profile::ScopedTimer(profile::Phase::MAKE_MOVE);
+            board.makeMove(mMoves[bestChildIdx]);
+        }
+
         return mChildren[bestChildIdx].select(board);
     }
 
-    inline Node* expand(Board &board) {
+    // Nets are run by evalPool's threads if not nullptr
+    inline Node* expand(Board &board, EvalPool *evalPool = nullptr) {
         assert(mMoves.size() > 0);
         assert(mChildren.size() < mMoves.size());
         assert(mGameState == GameState::ONGOING);
 
-        if (mPolicy.size() == 0)
-            policy::getPolicy(mPolicy, mMoves, board);
+        if (mPolicy.size() == 0) {
+            profile::ScopedTimer timer = profile::ScopedTimer(profile::Phase::POLICY);
+            if (evalPool != nullptr)
+                evalPool->getPolicy(mPolicy, mMoves, board);
+            else
+                policy::getPolicy(mPolicy, mMoves, board);
+        }
 
         // Incremental sort to get the next best move according to policy
         for (int i = mChildren.size(); i < mMoves.size(); i++)
@@ -105,11 +118,12 @@ struct Node {
         return &mChildren.back();
     }
 
-    inline double simulate(Board &board) {
+    inline double simulate(Board &board, EvalPool *evalPool = nullptr) {
         if (mGameState != GameState::ONGOING)
             return (double)mGameState;
 
-        double eval = value_nnue::evaluate(board.accumulator(), board.sideToMove());
+        double eval = evalPool != nullptr ? evalPool->evaluate(board)
+                      : value_nnue::evaluate(board.accumulator(), board.sideToMove());
         double wdl = 1.0 / (1.0 + exp(-eval / 200.0)); // [0, 1]
         wdl *= 2; // [0, 2]
         wdl -= 1; // [-1, 1]
@@ -147,6 +161,33 @@ struct Node {
         return { &mChildren[mostVisitsIdx], mMoves[mostVisitsIdx] };
     }
 
+    // Principal variation, following the most visited child
+    // Costs O(pv length * branching factor)
+    inline void pv(std::vector<Move> &pv) {
+        pv.clear();
+        Node *node = this;
+
+        while (node->mChildren.size() > 0) {
+            auto [child, move] = node->mostVisits();
+            pv.push_back(move);
+            node = child;
+        }
+    }
+
+    // Bytes used by this subtree, including unused vector capacity
+    inline u64 memoryBytes()
+    {
+        u64 bytes = sizeof(Node)
+                    + mMoves.capacity() * sizeof(Move)
+                    + mPolicy.capacity() * sizeof(float)
+                    + (mChildren.capacity() - mChildren.size()) * sizeof(Node);
+
+        for (Node &child : mChildren)
+            bytes += child.memoryBytes();
+
+        return bytes;
+    }
+
     inline std::string toString(int moveIdx = -1) 
     {
         assert(mVisits > 0);
@@ -0,0 +1,129 @@
+// clang-format off
+
+#pragma once
+
+// Tree statistics and memory accounting in a single O(nodes) pass, without printing every node
+
+struct TreeStats {
+    u64 nodes = 0,
+        terminalNodes = 0,       // checkmate or draw
+        expandedNodes = 0,       // at least 1 child
+        fullyExpandedNodes = 0,  // a child for every move
+        nonTerminalNodes = 0,
+        childrenSum = 0,         // of expanded nodes
+        movesSum = 0;            // of non terminal nodes
+
+    u64 nodesBytes = 0,          // sizeof(Node) of every node plus unused mChildren capacity
+        movesBytes = 0,          // mMoves capacity
+        policyBytes = 0;         // mPolicy capacity
+
+    std::vector<u64> depthHistogram = {}; // [depth]
+
+    inline TreeStats(Node &root)
+    {
+        std::vector<Node*> stack = { &root };
+
+        while (stack.size() > 0)
+        {
+            Node *node = stack.back();
+            stack.pop_back();
+
+            nodes++;
+            nodesBytes += sizeof(Node) + (node->mChildren.capacity() - node->mChildren.size()) * sizeof(Node);
+            movesBytes += node->mMoves.capacity() * sizeof(Move);
+            policyBytes += node->mPolicy.capacity() * sizeof(float);
+
+            int depth = node->mDepth - root.mDepth;
+            if (depth >= depthHistogram.size())
+                depthHistogram.resize(depth + 1, 0);
+            depthHistogram[depth]++;
+
+            if (node->mGameState != GameState::ONGOING)
+                terminalNodes++;
+            else {
+                nonTerminalNodes++;
+                movesSum += node->mMoves.size();
+            }
+
+            if (node->mChildren.size() > 0) {
+                expandedNodes++;
+                childrenSum += node->mChildren.size();
+                fullyExpandedNodes += node->mChildren.size() == node->mMoves.size();
+            }
+
+            for (Node &child : node->mChildren)
+                stack.push_back(&child);
+        }
+    }
+
+    inline u64 totalBytes() { return nodesBytes + movesBytes + policyBytes; }
+
+    inline void print(Node &root)
+    {
+        auto percentage = [](u64 part, u64 total) {
+            return roundToDecimalPlaces(100.0 * (double)part / (double)max(total, (u64)1), 2) + "%";
+        };
+
+        std::cout << "nodes " << nodes
+                  << " terminal " << terminalNodes
+                  << " expanded " << expandedNodes
+                  << " fully expanded " << fullyExpandedNodes
+                  << " (" << percentage(fullyExpandedNodes, expandedNodes) << " of expanded, "
+                  << percentage(fullyExpandedNodes, nonTerminalNodes) << " of non terminal)"
+                  << std::endl;
+
+        std::cout << "bytes " << totalBytes()
+                  << " (" << roundToDecimalPlaces((double)totalBytes() / (1024.0 * 1024.0), 2) << " MB)"
+                  << " nodes " << nodesBytes
+                  << " moves " << movesBytes
+                  << " policy " << policyBytes
+                  << " bytes/node " << totalBytes() / max(nodes, (u64)1)
+                  << std::endl;
+
+        std::cout << "branching factor "
+                  << roundToDecimalPlaces((double)childrenSum / (double)max(expandedNodes, (u64)1), 2)
+                  << " (children per expanded node)"
+                  << " legal moves per node "
+                  << roundToDecimalPlaces((double)movesSum / (double)max(nonTerminalNodes, (u64)1), 2)
+                  << std::endl;
+
+        std::cout << "depth histogram";
+        for (int depth = 0; depth < depthHistogram.size(); depth++)
+            std::cout << " " << depth << ":" << depthHistogram[depth];
+        std::cout << std::endl;
+
+        std::vector<Move> pv = {};
+        root.pv(pv);
+        std::cout << "pv length " << pv.size() << " pv";
+        for (Move move : pv)
+            std::cout << " " << move.toUci();
+        std::cout << std::endl;
+
+        if (root.mChildren.size() == 0) return;
+
+        // Root visit distribution, most visited first
+        std::vector<int> childrenIdxs = {};
+        for (int i = 0; i < root.mChildren.size(); i++)
+            childrenIdxs.push_back(i);
+
+        std::stable_sort(childrenIdxs.begin(), childrenIdxs.end(), [&](int a, int b) {
+            return root.mChildren[a].mVisits > root.mChildren[b].mVisits;
+        });
+
+        std::cout << "root visits " << root.mVisits << std::endl;
+        for (int i : childrenIdxs)
+        {
+            Node &child = root.mChildren[i];
+            std::cout << "  " << root.mMoves[i].toUci()
+                      << " visits " << child.mVisits
+                      << " (" << percentage(child.mVisits, root.mVisits) << ")"
+                      << " Q " << roundToDecimalPlaces(child.Q(), 4)
+                      << " policy " << roundToDecimalPlaces(root.mPolicy[i], 4)
+                      << std::endl;
+        }
+
+        u64 unexpandedMoves = root.mMoves.size() - root.mChildren.size();
+        if (unexpandedMoves > 0)
+            std::cout << "  (" << unexpandedMoves << " unexpanded moves)" << std::endl;
+    }
+};
@@ -91,6 +91,13 @@ enum class GameState : i8
 
 const u64 ONES = 0xFFFF'FFFF'FFFF'FFFF;
 
+const u64 FILE_A_BB = 0x0101'0101'0101'0101,
+          FILE_H_BB = FILE_A_BB << 7,
+          RANK_1_BB = 0xFF,
+          RANK_3_BB = RANK_1_BB << 16,
+          RANK_6_BB = RANK_1_BB << 40,
+          RANK_8_BB = RANK_1_BB << 56;
+
 const u8 CASTLE_SHORT = 0, CASTLE_LONG = 1;
 
 const i32 INF = 9999999;
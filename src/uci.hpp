@@ -3,7 +3,11 @@
 // clang-format-off
 
 #include "perft.hpp"
+#include "perf_counters.hpp"
 #include "bench.hpp"
+#include "tree_stats.hpp"
+#include "analyse.hpp"
+#include "datagen.hpp"
 
 namespace uci { // Universal chess interface
 
@@ -12,6 +16,9 @@ inline void setoption(Searcher &searcher, std::vector<std::string> &tokens);
 inline void ucinewgame(Searcher &searcher);
 inline void position(Searcher &searcher, std::vector<std::string> &tokens);
 inline void go(Searcher &searcher, std::vector<std::string> &tokens);
+inline PerftSettings parsePerftSettings(std::vector<std::string> &tokens);
+inline AnalyseSettings parseAnalyseSettings(std::vector<std::string> &tokens);
+inline DatagenSettings parseDatagenSettings(std::vector<std::string> &tokens);
 
 inline void uciLoop(Searcher &searcher)
 {
@@ -43,28 +50,51 @@ inline void uciLoop(Searcher &searcher)
         else if (tokens[0] == "print" || tokens[0] == "d"
         || tokens[0] == "display" || tokens[0] == "show")
             searcher.mBoard.print();
-        else if (tokens[0] == "perft")
+        else if (tokens[0] == "perft") // e.g. "perft 6 threads 4 hash 256"
         {
             int depth = stoi(tokens[1]);
-            perftBench(searcher.mBoard, depth);
+            perftBench(searcher.mBoard, depth, parsePerftSettings(tokens));
         }
         else if (tokens[0] == "perftsplit" 
         || tokens[0] == "splitperft" 
         || tokens[0] == "perftdivide")
         {
             int depth = stoi(tokens[1]);
-            perftSplit(searcher.mBoard, depth);
+            perftSplit(searcher.mBoard, depth, parsePerftSettings(tokens));
         }
-        else if (tokens[0] == "bench")
+        else if (tokens[0] == "perftsuite") // e.g. "perftsuite standard.epd threads 4"
+            perftSuite(tokens[1], parsePerftSettings(tokens));
+        else if (tokens[0] == "analyse" || tokens[0] == "analyze") // e.g. "analyse in.epd out.jsonl nodes 10000 threads 8"
+            analyse(tokens[1], tokens[2], parseAnalyseSettings(tokens));
+        else if (tokens[0] == "datagen") // e.g. "datagen out.bin nodes 1000 threads 8 positions 1000000"
+            datagen(tokens[1], parseDatagenSettings(tokens));
+        else if (tokens[0] == "bench") // e.g. "bench", "bench 10", "bench 10 perf", "bench json nodes 5000 threads 4 evalthreads 2"
         {
-            if (tokens.size() > 1)
-            {
-                int depth = stoi(tokens[1]);
-                bench(depth);
-            }
+            int depth = 14, threads = 1, evalThreads = 0;
+            u64 nodes = 10000;
+            bool usePerfCounters = false, json = false;
+
+            for (int i = 1; i < tokens.size(); i++)
+                if (tokens[i] == "perf")
+                    usePerfCounters = true;
+                else if (tokens[i] == "json")
+                    json = true;
+                else if (tokens[i] == "nodes" && i + 1 < tokens.size())
+                    nodes = std::stoull(tokens[++i]);
+                else if (tokens[i] == "threads" && i + 1 < tokens.size())
+                    threads = std::clamp(stoi(tokens[++i]), 1, 256);
+                else if (tokens[i] == "evalthreads" && i + 1 < tokens.size())
+                    evalThreads = std::clamp(stoi(tokens[++i]), 0, 256);
+                else
+                    depth = stoi(tokens[i]);
+
+            if (json)
+                jsonBench(nodes, threads, evalThreads);
             else
-                bench();
+                bench(depth, usePerfCounters, threads, evalThreads);
         }
+        else if (received == "profile")
+            profile::print(searcher.mProfileStats);
         else if (received == "eval") {
             std::cout << value_nnue::evaluate(searcher.mBoard.accumulator(), 
                                               searcher.mBoard.sideToMove()) 
@@ -81,6 +111,8 @@ inline void uciLoop(Searcher &searcher)
         }
         else if (received == "tree" && searcher.mNodes > 0)
             searcher.mRoot.printTree();
+        else if (received == "treestats" && searcher.mNodes > 0)
+            TreeStats(searcher.mRoot).print(searcher.mRoot);
         else if (received == "tree 1" && searcher.mNodes > 0)
         {
             for (int i = 0; i < searcher.mRoot.mChildren.size(); i++)
@@ -105,6 +137,9 @@ inline void uci()
     std::cout << "id name New Century" << std::endl;
     std::cout << "id author zzzzz" << std::endl;
     std::cout << "option name Hash type spin default 32 min 1 max 1024" << std::endl;
+    std::cout << "option name MultiPV type spin default 1 min 1 max 256" << std::endl;
+    std::cout << "option name Threads type spin default 1 min 1 max 256" << std::endl;
+    std::cout << "option name EvalThreads type spin default 0 min 0 max 256" << std::endl;
     std::cout << "uciok" << std::endl;
 }
 
@@ -118,6 +153,12 @@ inline void setoption(Searcher &searcher, std::vector<std::string> &tokens)
     if (optionName == "Hash" || optionName == "hash")
     {
     }
+    else if (optionName == "MultiPV" || optionName == "multipv")
+        searcher.mMultiPV = std::clamp(stoi(optionValue), 1, 256);
+    else if (optionName == "Threads" || optionName == "threads")
+        searcher.mThreads = std::clamp(stoi(optionValue), 1, 256);
+    else if (optionName == "EvalThreads" || optionName == "evalthreads")
+        searcher.setEvalThreads(std::clamp(stoi(optionValue), 0, 256));
 }
 
 inline void ucinewgame(Searcher &searcher)
@@ -189,6 +230,60 @@ inline void go(Searcher &searcher, std::vector<std::string> &tokens)
     std::cout << "bestmove " + bestMove.toUci() << std::endl;
 }
 
+inline PerftSettings parsePerftSettings(std::vector<std::string> &tokens)
+{
+    PerftSettings settings = PerftSettings();
+
+    // tokens[0] is the command and tokens[1] the depth or file
+    for (int i = 2; i < (int)tokens.size() - 1; i += 2)
+    {
+        if (tokens[i] == "threads")
+            settings.threads = max(stoi(tokens[i + 1]), 1);
+        else if (tokens[i] == "hash")
+            settings.hashMegabytes = max(stoi(tokens[i + 1]), 1);
+    }
+
+    return settings;
+}
+
+inline AnalyseSettings parseAnalyseSettings(std::vector<std::string> &tokens)
+{
+    AnalyseSettings settings = AnalyseSettings();
+
+    // tokens[0] is the command, tokens[1] the input file and tokens[2] the output file
+    for (int i = 3; i < (int)tokens.size() - 1; i += 2)
+    {
+        if (tokens[i] == "nodes")
+            settings.nodes = max((u64)std::stoull(tokens[i + 1]), (u64)1);
+        else if (tokens[i] == "threads")
+            settings.threads = max(stoi(tokens[i + 1]), 1);
+    }
+
+    return settings;
+}
+
+inline DatagenSettings parseDatagenSettings(std::vector<std::string> &tokens)
+{
+    DatagenSettings settings = DatagenSettings();
+
+    // tokens[0] is the command and tokens[1] the output file
+    for (int i = 2; i < (int)tokens.size() - 1; i += 2)
+    {
+        if (tokens[i] == "nodes")
+            settings.nodes = max((u64)std::stoull(tokens[i + 1]), (u64)1);
+        else if (tokens[i] == "threads")
+            settings.threads = max(stoi(tokens[i + 1]), 1);
+        else if (tokens[i] == "positions")
+            settings.positions = std::stoull(tokens[i + 1]);
+        else if (tokens[i] == "openingplies")
+            settings.openingPlies = max(stoi(tokens[i + 1]), 0);
+        else if (tokens[i] == "seed")
+            settings.seed = std::stoull(tokens[i + 1]);
+    }
+
+    return settings;
+}
+
 } // namespace uci
 
 
@@ -63,6 +63,16 @@ inline u64 pdep(u64 val, u64 mask) {
     return res;
 }
 
+inline u64 pext(u64 val, u64 mask) {
+    u64 res = 0;
+    for (u64 bb = 1; mask; bb += bb) {
+        if (val & mask & -mask)
+            res |= bb;
+        mask &= mask - 1;
+    }
+    return res;
+}
+
 inline Color oppColor(Color color)
 {
     assert(color != Color::NONE);
@@ -0,0 +1,109 @@
+import ctypes
+import numpy as np
+import torch
+
+# ctypes wrapper of converter/batch_loader.cpp, see converter/batch_loader.hpp for the batch layout
+# Build it from the converter folder with
+# clang++ -std=c++20 -O3 -march=native -shared -fPIC batch_loader.cpp -o batch_loader.so
+
+FORMAT_DATA_ENTRY = 0
+FORMAT_DATA_ENTRY_WITH_VISITS = 1
+FORMAT_PACKED = 2
+FORMAT_PACKED_WITH_VISITS = 3
+FORMAT_COMPRESSED = 4
+
+INPUT_SIZE = 768
+
+class NativeBatchLoader:
+    # With compactOutputs, moves are compact policy output indexes instead of moves4096, see converter/policy_outputs.hpp
+    def __init__(self, libFileName, dataFileName, dataFormat, batchSize, threads, slots=4, shuffle=True, seed=42,
+                 compactOutputs=False):
+        self.lib = ctypes.CDLL(libFileName)
+        self.batchSize = batchSize
+
+        self.lib.loaderOpen.restype = ctypes.c_void_p
+        self.lib.loaderOpen.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_uint64,
+            ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_uint64, ctypes.c_int]
+
+        for name in ["loaderClose", "loaderRelease"]:
+            getattr(self.lib, name).restype = None
+
+        for name in ["loaderNumEntries", "loaderNumBatchesPerEpoch"]:
+            getattr(self.lib, name).restype = ctypes.c_uint64
+
+        self.lib.loaderClose.argtypes = [ctypes.c_void_p]
+        self.lib.loaderNumEntries.argtypes = [ctypes.c_void_p]
+        self.lib.loaderNumBatchesPerEpoch.argtypes = [ctypes.c_void_p]
+        self.lib.loaderNext.argtypes = [ctypes.c_void_p]
+        self.lib.loaderRelease.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.lib.loaderOutputSize.argtypes = [ctypes.c_void_p]
+
+        self.loader = self.lib.loaderOpen(dataFileName.encode(), dataFormat, batchSize,
+            threads, slots, int(shuffle), seed, int(compactOutputs))
+        assert self.loader, "Error opening {} or less than 1 batch".format(dataFileName)
+
+        self.maxActiveInputs = self.lib.loaderMaxActiveInputs()
+        self.maxTargets = self.lib.loaderMaxTargets()
+        self.outputSize = self.lib.loaderOutputSize(self.loader)
+
+        # Numpy views of each slot's buffers, sharing memory with the library
+        def view(name, ctype, shape, slot):
+            getattr(self.lib, name).restype = ctypes.POINTER(ctype)
+            getattr(self.lib, name).argtypes = [ctypes.c_void_p, ctypes.c_int]
+            return np.ctypeslib.as_array(getattr(self.lib, name)(self.loader, slot), shape=shape)
+
+        self.slots = []
+        for slot in range(slots):
+            self.slots.append({
+                "inputs": view("loaderInputs", ctypes.c_int64, (batchSize, self.maxActiveInputs), slot),
+                "legal": view("loaderLegal", ctypes.c_uint8, (batchSize, self.outputSize), slot),
+                "bestMoves": view("loaderBestMoves", ctypes.c_int64, (batchSize,), slot),
+                "targetMoves": view("loaderTargetMoves", ctypes.c_int64, (batchSize, self.maxTargets), slot),
+                "targetProbs": view("loaderTargetProbs", ctypes.c_float, (batchSize, self.maxTargets), slot),
+                "results": view("loaderResults", ctypes.c_float, (batchSize,), slot),
+                "evals": view("loaderEvals", ctypes.c_float, (batchSize,), slot)
+            })
+
+    def numEntries(self):
+        return self.lib.loaderNumEntries(self.loader)
+
+    def numBatchesPerEpoch(self):
+        return self.lib.loaderNumBatchesPerEpoch(self.loader)
+
+    # Returns (inputs, illegals, bestMoves, targetProbs) on device, with dense inputs [batch][768],
+    # illegals [batch][outputSize] and visit target probabilities [batch][outputSize]
+    # If labels, also returns the game results and value net eval labels [batch], from stm perspective
+    def next(self, device, labels=False):
+        slot = self.lib.loaderNext(self.loader)
+        buffers = self.slots[slot]
+
+        # Copy to device before the slot is reused
+        inputsIdxs = torch.from_numpy(buffers["inputs"]).to(device, copy=True)
+        legal = torch.from_numpy(buffers["legal"]).to(device, copy=True)
+        bestMoves = torch.from_numpy(buffers["bestMoves"]).to(device, copy=True)
+        targetMoves = torch.from_numpy(buffers["targetMoves"]).to(device, copy=True)
+        targetProbs = torch.from_numpy(buffers["targetProbs"]).to(device, copy=True)
+        if labels:
+            results = torch.from_numpy(buffers["results"]).to(device, copy=True)
+            evals = torch.from_numpy(buffers["evals"]).to(device, copy=True)
+        self.lib.loaderRelease(self.loader, slot)
+
+        # Padding indexes are INPUT_SIZE and outputSize, so scatter 1 column wider and drop it
+        inputs = torch.zeros(self.batchSize, INPUT_SIZE + 1, device=device)
+        inputs.scatter_(1, inputsIdxs, 1)
+
+        targets = torch.zeros(self.batchSize, self.outputSize + 1, device=device)
+        targets.scatter_(1, targetMoves, targetProbs)
+
+        if labels:
+            return (inputs[:, :INPUT_SIZE], legal == 0, bestMoves, targets[:, :self.outputSize], results, evals)
+
+        return (inputs[:, :INPUT_SIZE], legal == 0, bestMoves, targets[:, :self.outputSize])
+
+    def close(self):
+        if self.loader:
+            self.lib.loaderClose(self.loader)
+            self.loader = None
+
+    def __del__(self):
+        self.close()
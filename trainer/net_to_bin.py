@@ -35,16 +35,18 @@ if __name__ == "__main__":
         
     # save .bin
     with open(OUTPUT_FOLDER + "/" + netFileRaw + ".bin", 'wb') as binFile:
-        # Write weights1
-        for i in range(INPUT_SIZE):
-            for j in range(HIDDEN_SIZE):
-                weight = np.float32(net.conn1.weight[j, i].item())
-                weight.tofile(binFile)
-
-        # Write hidden biases
-        for i in range(HIDDEN_SIZE):
-            bias = np.float32(net.conn1.bias[i].cpu().detach().numpy())
-            bias.tofile(binFile)
+        # Shared trunk nets have no first layer of their own, the engine reads the value accumulator
+        if not SHARED_TRUNK_NET:
+            # Write weights1
+            for i in range(INPUT_SIZE):
+                for j in range(HIDDEN_SIZE):
+                    weight = np.float32(net.conn1.weight[j, i].item())
+                    weight.tofile(binFile)
+
+            # Write hidden biases
+            for i in range(HIDDEN_SIZE):
+                bias = np.float32(net.conn1.bias[i].cpu().detach().numpy())
+                bias.tofile(binFile)
 
         # Write weights2
         for i in range(OUTPUT_SIZE):
@@ -0,0 +1,46 @@
+import sys
+from array import array
+
+# Converts a .bin policy net with 4096 outputs to the compact output layer (build the engine with -DPOLICY_COMPACT)
+# The dropped outputs are moves no piece can make, so the compact net's policy is the same
+# Usage: python3 net_to_compact.py nets-bin/netEpoch40.bin nets-bin/netEpoch40_compact.bin
+
+INPUT_SIZE = 768
+HIDDEN_SIZE = 32
+
+# Same order as policy::OUTPUT_IDXS
+def compactMoves4096():
+    moves4096 = []
+    for fromSq in range(64):
+        for toSq in range(64):
+            fileDiff = abs(fromSq % 8 - toSq % 8)
+            rankDiff = abs(fromSq // 8 - toSq // 8)
+            if fromSq != toSq and (fileDiff == 0 or rankDiff == 0 or fileDiff == rankDiff or fileDiff * rankDiff == 2):
+                moves4096.append(fromSq * 64 + toSq)
+    return moves4096
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print("Invalid num of args, expected <input .bin> <output .bin>")
+        exit(1)
+
+    net = array('f')
+    with open(sys.argv[1], 'rb') as inFile:
+        net.frombytes(inFile.read())
+
+    assert len(net) == INPUT_SIZE * HIDDEN_SIZE + HIDDEN_SIZE + 4096 * HIDDEN_SIZE + 4096, "Not a 4096 outputs net"
+
+    weights1AndBiases = net[:INPUT_SIZE * HIDDEN_SIZE + HIDDEN_SIZE]
+    weights2 = net[len(weights1AndBiases):len(weights1AndBiases) + 4096 * HIDDEN_SIZE]
+    outputBiases = net[len(weights1AndBiases) + 4096 * HIDDEN_SIZE:]
+
+    compactNet = array('f', weights1AndBiases)
+    for move4096 in compactMoves4096():
+        compactNet.extend(weights2[move4096 * HIDDEN_SIZE:(move4096 + 1) * HIDDEN_SIZE])
+    for move4096 in compactMoves4096():
+        compactNet.append(outputBiases[move4096])
+
+    with open(sys.argv[2], 'wb') as outFile:
+        compactNet.tofile(outFile)
+
+    print("Outputs: {} -> {}, bytes: {} -> {}".format(4096, len(compactMoves4096()), len(net) * 4, len(compactNet) * 4))
@@ -36,19 +36,22 @@ def printPolicyFromFen(net: Net, fen: str):
             return (mov.from_square ^ 56) * 64 + (mov.to_square ^ 56)
         return mov.from_square * 64 + mov.to_square
 
+    def outputIdx(mov):
+        return OUTPUT_IDXS[moveTo4096(mov)]
+
     moves = list(chess.Board(fen).legal_moves)
     illegals = torch.ones(OUTPUT_SIZE)
 
     for move in moves:
-        illegals[moveTo4096(move)] = 0
+        illegals[outputIdx(move)] = 0
 
     output = net(inputs, illegals)
     output = torch.nn.functional.softmax(output, dim=0)
 
-    moves.sort(key=lambda move: output[moveTo4096(move)], reverse=True)
+    moves.sort(key=lambda move: output[outputIdx(move)], reverse=True)
     for move in moves:
         print("{} ({}): {:.4f}".format(
-            move.uci(), moveTo4096(move), output[moveTo4096(move)]))
+            move.uci(), moveTo4096(move), output[outputIdx(move)]))
 
 def printPolicyFromDataEntry(net: Net, dataset: MyDataset, i: int):
     print("DataEntry index", i)
@@ -64,7 +67,7 @@ def printPolicyFromDataEntry(net: Net, dataset: MyDataset, i: int):
 
     policiedMoves = []
     for move4096 in dataset.entries[i].moves4096:
-        policiedMoves.append(PoliciedMove(move4096=move4096, score=output[move4096]))
+        policiedMoves.append(PoliciedMove(move4096=move4096, score=output[OUTPUT_IDXS[move4096]]))
 
     policiedMoves.sort(key = lambda policiedMove: policiedMove.score, reverse=True)
     for policiedMove in policiedMoves:
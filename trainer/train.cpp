@@ -0,0 +1,465 @@
+// clang-format off
+
+// Native CPU trainer for the policy net, training like train.py without its dense compute
+// Build from the trainer folder with
+// clang++ -std=c++20 -O3 -march=native -pthread train.cpp -o train
+// Usage: train <data file> <format> [option=value ...], with the batch loader formats and the options of TrainSettings
+//
+// Same net, loss and optimizer as train.py: 768->32 (relu)->4096, cross entropy of the softmax over legal moves
+// against the best move or the visits distribution, and Adam with the same LR drop
+// Only the active inputs (~32 of 768) and the legal moves (~35 of 4096) of each position are computed,
+// forward and backward, and each thread accumulates the gradients of its part of the batch
+// Nets are saved every epoch in the net_to_bin.py .bin layout, which policy.hpp loads as is
+// Build with -DPOLICY_COMPACT to train the compact output layer (768->32->1792) of engines built with -DPOLICY_COMPACT
+// Build with -DPOLICY_SHARED_TRUNK to train only the output layer on top of a value net's first layer, which is frozen,
+// for engines built with -DPOLICY_SHARED_TRUNK and that value net (valuenet=src/value_net.nnue)
+
+#include <fstream>
+#include <filesystem>
+#include <barrier>
+#include <functional>
+#include <immintrin.h>
+#include "../converter/batch_loader.hpp"
+
+#if defined(POLICY_SHARED_TRUNK)
+    #include "../converter/value_nnue.hpp"
+#endif
+
+#if defined(POLICY_COMPACT)
+constexpr int INPUT_SIZE = 768, HIDDEN_SIZE = 32, OUTPUT_SIZE = OUTPUT_SIZE_COMPACT;
+#else
+constexpr int INPUT_SIZE = 768, HIDDEN_SIZE = 32, OUTPUT_SIZE = OUTPUT_SIZE_4096;
+#endif
+
+// Same layout as policy::Net, also used for gradients and Adam moments
+struct alignas(64) Net {
+    #if defined(POLICY_SHARED_TRUNK)
+        static constexpr u64 NUM_FIRST_LAYER_PARAMS = 0;
+    #else
+        std::array<std::array<float, HIDDEN_SIZE>, INPUT_SIZE> weights1; // [inputIdx][hiddenNeuronIdx]
+        std::array<float, HIDDEN_SIZE> hiddenBiases;
+
+        static constexpr u64 NUM_FIRST_LAYER_PARAMS = INPUT_SIZE * HIDDEN_SIZE + HIDDEN_SIZE;
+    #endif
+
+    std::array<std::array<float, HIDDEN_SIZE>, OUTPUT_SIZE> weights2; // [outputNeuronIdx][hiddenNeuronIdx]
+    std::array<float, OUTPUT_SIZE> outputBiases;
+
+    static constexpr u64 NUM_PARAMS = NUM_FIRST_LAYER_PARAMS + OUTPUT_SIZE * HIDDEN_SIZE + OUTPUT_SIZE;
+
+    inline float* params() { return reinterpret_cast<float*>(this); }
+};
+
+static_assert(sizeof(Net) == Net::NUM_PARAMS * sizeof(float));
+
+// y += x * alpha, over HIDDEN_SIZE floats
+inline void addScaled(float *y, const float *x, float alpha)
+{
+    #if defined(__AVX2__) && defined(__FMA__)
+        const __m256 vecAlpha = _mm256_set1_ps(alpha);
+        for (int i = 0; i < HIDDEN_SIZE; i += 8)
+            _mm256_storeu_ps(y + i, _mm256_fmadd_ps(_mm256_loadu_ps(x + i), vecAlpha, _mm256_loadu_ps(y + i)));
+    #else
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+            y[i] += x[i] * alpha;
+    #endif
+}
+
+// Dot product of HIDDEN_SIZE floats
+inline float dot(const float *x, const float *y)
+{
+    #if defined(__AVX2__) && defined(__FMA__)
+        __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(x), _mm256_loadu_ps(y));
+        for (int i = 8; i < HIDDEN_SIZE; i += 8)
+            sum = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum);
+
+        __m128 sum128 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        sum128 = _mm_add_ps(sum128, _mm_movehl_ps(sum128, sum128));
+        sum128 = _mm_add_ss(sum128, _mm_movehdup_ps(sum128));
+        return _mm_cvtss_f32(sum128);
+    #else
+        float sum = 0;
+        for (int i = 0; i < HIDDEN_SIZE; i++)
+            sum += x[i] * y[i];
+        return sum;
+    #endif
+}
+
+struct TrainSettings {
+    public:
+
+    std::string dataFileName;
+    DataFormat format;
+    std::string checkpoint = ""; // .bin net to resume from, empty = random weights
+    int startEpoch = 1;
+    int epochs = 40;
+    u64 batchSize = 16384;
+    float lr = 0.001;
+    int lrDropEpoch = 20;
+    float lrDropMultiplier = 0.2;
+    int threads = max((int)std::thread::hardware_concurrency(), 1);
+    int loaderThreads = 4;
+    std::string netsFolder = "nets";
+    u64 seed = 42;
+    std::string valueNet = ""; // Value net whose first layer is the trunk, with -DPOLICY_SHARED_TRUNK
+};
+
+class Trainer {
+    private:
+
+    TrainSettings mSettings;
+    std::unique_ptr<Net> mNet, mAdamM, mAdamV;
+    std::vector<std::unique_ptr<Net>> mGradients; // [thread]
+    std::vector<double> mLosses; // [thread]
+    u64 mAdamStep = 0;
+
+    // Worker threads run mJob(threadIdx) between 2 barrier phases
+    std::vector<std::thread> mThreads;
+    std::barrier<> mBarrier;
+    std::function<void(int)> mJob;
+    bool mStop = false;
+
+    public:
+
+    inline Trainer(TrainSettings settings)
+        : mSettings(settings), mBarrier(settings.threads + 1)
+    {
+        mNet = std::make_unique<Net>();
+        mAdamM = std::make_unique<Net>();
+        mAdamV = std::make_unique<Net>();
+        std::fill(mAdamM->params(), mAdamM->params() + Net::NUM_PARAMS, 0.0f);
+        std::fill(mAdamV->params(), mAdamV->params() + Net::NUM_PARAMS, 0.0f);
+
+        for (int i = 0; i < settings.threads; i++)
+            mGradients.push_back(std::make_unique<Net>());
+
+        mLosses.resize(settings.threads);
+
+        // Random weights and biases like train.py, though not the same numbers as torch
+        std::mt19937_64 rng(settings.seed);
+        std::uniform_real_distribution<float> distribution(-1, 1);
+        for (u64 i = 0; i < Net::NUM_PARAMS; i++)
+            mNet->params()[i] = distribution(rng);
+
+        for (int i = 0; i < settings.threads; i++)
+            mThreads.emplace_back([this, i]() {
+                while (true) {
+                    mBarrier.arrive_and_wait();
+                    if (mStop) return;
+                    mJob(i);
+                    mBarrier.arrive_and_wait();
+                }
+            });
+    }
+
+    inline ~Trainer()
+    {
+        mStop = true;
+        mBarrier.arrive_and_wait();
+
+        for (std::thread &thread : mThreads)
+            thread.join();
+    }
+
+    inline bool loadNet(std::string fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        file.read(reinterpret_cast<char*>(mNet.get()), sizeof(Net));
+        return !file.fail();
+    }
+
+    inline bool saveNet(std::string fileName)
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(mNet.get()), sizeof(Net));
+        return !file.fail();
+    }
+
+    // Trains on 1 batch and returns its average loss
+    inline double trainBatch(BatchSlot &slot, float lr)
+    {
+        runJob([&](int threadIdx) {
+            u64 begin = mSettings.batchSize * threadIdx / mSettings.threads;
+            u64 end = mSettings.batchSize * (threadIdx + 1) / mSettings.threads;
+            mLosses[threadIdx] = computeGradients(slot, begin, end, *mGradients[threadIdx]);
+        });
+
+        mAdamStep++;
+
+        runJob([&](int threadIdx) {
+            u64 begin = Net::NUM_PARAMS * threadIdx / mSettings.threads;
+            u64 end = Net::NUM_PARAMS * (threadIdx + 1) / mSettings.threads;
+            adam(begin, end, lr);
+        });
+
+        double loss = 0;
+        for (double threadLoss : mLosses)
+            loss += threadLoss;
+
+        return loss / mSettings.batchSize;
+    }
+
+    private:
+
+    inline void runJob(std::function<void(int)> job)
+    {
+        mJob = job;
+        mBarrier.arrive_and_wait(); // Start
+        mBarrier.arrive_and_wait(); // Wait until all threads are done
+    }
+
+    // Overwrites gradients with the loss gradients summed over entries [begin, end) of the batch
+    // and returns the summed loss
+    inline double computeGradients(BatchSlot &slot, u64 begin, u64 end, Net &gradients)
+    {
+        std::fill(gradients.params(), gradients.params() + Net::NUM_PARAMS, 0.0f);
+
+        std::array<float, OUTPUT_SIZE + 1> targetProbs; // [outputIdx], with a slot for padding
+        targetProbs.fill(0);
+
+        std::array<float, MAX_MOVES> outputs;
+        alignas(32) std::array<float, HIDDEN_SIZE> activated, activatedGradients;
+        double totalLoss = 0;
+
+        for (u64 i = begin; i < end; i++)
+        {
+            const i64 *inputs = &slot.inputs[i * MAX_ACTIVE_INPUTS];
+            const i16 *legalMoves = &slot.legalMoves[i * MAX_MOVES];
+            const i64 *targetMoves = &slot.targetMoves[i * MAX_TARGETS];
+            const float *probs = &slot.targetProbs[i * MAX_TARGETS];
+
+            #if defined(POLICY_SHARED_TRUNK)
+                // Hidden layer is the frozen value net trunk, clipped and dequantized like policy::getPolicy()
+                int numInputs = 0;
+                while (numInputs < MAX_ACTIVE_INPUTS && inputs[numInputs] < INPUT_SIZE) numInputs++;
+
+                std::array<i16, HIDDEN_SIZE> trunk;
+                value_nnue::stmAccumulator(inputs, numInputs, trunk.data(), HIDDEN_SIZE);
+
+                for (int j = 0; j < HIDDEN_SIZE; j++)
+                    activated[j] = (float)std::clamp<i32>(trunk[j], 0, value_nnue::QA) / (float)value_nnue::QA;
+            #else
+                // Hidden layer is the sum of the active inputs' weights
+                alignas(32) std::array<float, HIDDEN_SIZE> hidden = mNet->hiddenBiases;
+                for (int j = 0; j < MAX_ACTIVE_INPUTS && inputs[j] < INPUT_SIZE; j++)
+                    addScaled(hidden.data(), mNet->weights1[inputs[j]].data(), 1);
+
+                for (int j = 0; j < HIDDEN_SIZE; j++)
+                    activated[j] = max(hidden[j], 0.0f);
+            #endif
+
+            // Softmax over legal moves only
+            int numMoves = 0;
+            float maxOutput = -INFINITY;
+
+            for (; numMoves < MAX_MOVES && legalMoves[numMoves] < OUTPUT_SIZE; numMoves++) {
+                int outputIdx = legalMoves[numMoves];
+                outputs[numMoves] = mNet->outputBiases[outputIdx] + dot(mNet->weights2[outputIdx].data(), activated.data());
+                maxOutput = max(maxOutput, outputs[numMoves]);
+            }
+
+            float expSum = 0;
+            for (int j = 0; j < numMoves; j++)
+                expSum += exp(outputs[j] - maxOutput);
+
+            float logExpSum = maxOutput + log(expSum);
+
+            for (int j = 0; j < MAX_TARGETS && targetMoves[j] < OUTPUT_SIZE; j++)
+                targetProbs[targetMoves[j]] = probs[j];
+
+            // Cross entropy loss and its gradients, d(loss)/d(output) = prob - targetProb
+            activatedGradients.fill(0);
+
+            for (int j = 0; j < numMoves; j++)
+            {
+                int outputIdx = legalMoves[j];
+                float targetProb = targetProbs[outputIdx];
+                totalLoss -= targetProb * (outputs[j] - logExpSum);
+
+                float outputGradient = exp(outputs[j] - logExpSum) - targetProb;
+                gradients.outputBiases[outputIdx] += outputGradient;
+                addScaled(gradients.weights2[outputIdx].data(), activated.data(), outputGradient);
+                addScaled(activatedGradients.data(), mNet->weights2[outputIdx].data(), outputGradient);
+            }
+
+            for (int j = 0; j < MAX_TARGETS && targetMoves[j] < OUTPUT_SIZE; j++)
+                targetProbs[targetMoves[j]] = 0;
+
+            #if !defined(POLICY_SHARED_TRUNK)
+                // Back through relu
+                for (int j = 0; j < HIDDEN_SIZE; j++)
+                    activatedGradients[j] = hidden[j] > 0 ? activatedGradients[j] : 0;
+
+                addScaled(gradients.hiddenBiases.data(), activatedGradients.data(), 1);
+                for (int j = 0; j < MAX_ACTIVE_INPUTS && inputs[j] < INPUT_SIZE; j++)
+                    addScaled(gradients.weights1[inputs[j]].data(), activatedGradients.data(), 1);
+            #endif
+        }
+
+        return totalLoss;
+    }
+
+    // Same update as torch.optim.Adam with default betas and eps, on params [begin, end)
+    inline void adam(u64 begin, u64 end, float lr)
+    {
+        constexpr double BETA1 = 0.9, BETA2 = 0.999, EPSILON = 1e-8;
+        const double biasCorrection1 = 1.0 - pow(BETA1, mAdamStep);
+        const double biasCorrection2Sqrt = sqrt(1.0 - pow(BETA2, mAdamStep));
+        const float stepSize = lr / biasCorrection1;
+
+        float *params = mNet->params(), *m = mAdamM->params(), *v = mAdamV->params();
+
+        for (u64 i = begin; i < end; i++)
+        {
+            float gradient = 0;
+            for (std::unique_ptr<Net> &threadGradients : mGradients)
+                gradient += threadGradients->params()[i];
+
+            gradient /= mSettings.batchSize; // Loss is the batch average
+
+            m[i] = BETA1 * m[i] + (1 - BETA1) * gradient;
+            v[i] = BETA2 * v[i] + (1 - BETA2) * gradient * gradient;
+            params[i] -= stepSize * m[i] / (sqrt(v[i]) / biasCorrection2Sqrt + EPSILON);
+        }
+    }
+};
+
+inline bool parseTrainSettings(int argc, char* argv[], TrainSettings &settings)
+{
+    if (argc < 3) return false;
+
+    settings.dataFileName = argv[1];
+    settings.format = (DataFormat)atoi(argv[2]);
+
+    for (int i = 3; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t separatorIdx = arg.find('=');
+        if (separatorIdx == std::string::npos) return false;
+
+        std::string name = arg.substr(0, separatorIdx), value = arg.substr(separatorIdx + 1);
+
+        if (name == "checkpoint")
+            settings.checkpoint = value;
+        else if (name == "startepoch")
+            settings.startEpoch = max(stoi(value), 1);
+        else if (name == "epochs")
+            settings.epochs = stoi(value);
+        else if (name == "batchsize")
+            settings.batchSize = max(stoull(value), 1ULL);
+        else if (name == "lr")
+            settings.lr = stof(value);
+        else if (name == "lrdropepoch")
+            settings.lrDropEpoch = stoi(value);
+        else if (name == "lrdropmultiplier")
+            settings.lrDropMultiplier = stof(value);
+        else if (name == "threads")
+            settings.threads = max(stoi(value), 1);
+        else if (name == "loaderthreads")
+            settings.loaderThreads = max(stoi(value), 1);
+        else if (name == "netsfolder")
+            settings.netsFolder = value;
+        else if (name == "seed")
+            settings.seed = stoull(value);
+        else if (name == "valuenet")
+            settings.valueNet = value;
+        else
+            return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    TrainSettings settings = TrainSettings();
+
+    if (!parseTrainSettings(argc, argv, settings)) {
+        std::cout << "Invalid args, expected <data file> <format> [option=value ...]" << std::endl;
+        std::cout << "Options: checkpoint startepoch epochs batchsize lr lrdropepoch lrdropmultiplier "
+                  << "threads loaderthreads netsfolder seed valuenet" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Net arch: " << INPUT_SIZE << "->" << HIDDEN_SIZE << "->" << OUTPUT_SIZE << std::endl
+              << "Resuming from: " << (settings.checkpoint == "" ? "None" : settings.checkpoint) << std::endl
+              << "Start epoch: " << settings.startEpoch << std::endl
+              << "Epochs: " << settings.epochs << std::endl
+              << "Batch size: " << settings.batchSize << std::endl
+              << "Learning rate: " << settings.lr << std::endl
+              << "LR drop epoch: " << settings.lrDropEpoch << std::endl
+              << "LR drop multiplier: " << settings.lrDropMultiplier << std::endl
+              << "Threads: " << settings.threads << std::endl
+              << "Loader threads: " << settings.loaderThreads << std::endl
+              << "Nets folder: " << settings.netsFolder << std::endl
+              << "Data file: " << settings.dataFileName << std::endl
+              << "Data format: " << (int)settings.format << std::endl;
+
+    #if defined(POLICY_SHARED_TRUNK)
+        std::cout << "Shared trunk value net: " << settings.valueNet << std::endl;
+
+        if (!value_nnue::loadNet(settings.valueNet)) {
+            std::cout << "Error loading value net, required with -DPOLICY_SHARED_TRUNK" << std::endl;
+            return 1;
+        }
+    #endif
+
+    initUtils();
+    attacks::init();
+
+    Trainer trainer = Trainer(settings);
+
+    if (settings.checkpoint != "" && !trainer.loadNet(settings.checkpoint)) {
+        std::cout << "Error loading checkpoint" << std::endl;
+        return 1;
+    }
+
+    BatchLoader loader;
+    if (!loader.open(settings.dataFileName, settings.format, settings.batchSize, settings.loaderThreads, 4, true, settings.seed,
+                     OUTPUT_SIZE == OUTPUT_SIZE_COMPACT)) {
+        std::cout << "Error opening data file or less than 1 batch" << std::endl;
+        return 1;
+    }
+
+    u64 numBatches = loader.numBatchesPerEpoch();
+    std::cout << "Total positions: " << numBatches * settings.batchSize << std::endl << std::endl;
+
+    std::filesystem::create_directories(settings.netsFolder);
+
+    for (int epoch = settings.startEpoch; epoch <= settings.epochs; epoch++)
+    {
+        std::chrono::steady_clock::time_point epochStart = std::chrono::steady_clock::now();
+        double totalEpochLoss = 0;
+
+        float lr = epoch - 1 >= settings.lrDropEpoch ? settings.lr * settings.lrDropMultiplier : settings.lr;
+        if (epoch - 1 == settings.lrDropEpoch)
+            std::cout << "LR dropped to " << std::fixed << std::setprecision(8) << lr << std::endl;
+
+        for (u64 batchIdx = 0; batchIdx < numBatches; batchIdx++)
+        {
+            int slotIdx = loader.next();
+            totalEpochLoss += trainer.trainBatch(loader.slot(slotIdx), lr);
+            loader.release(slotIdx);
+
+            if (batchIdx == 0 || batchIdx == numBatches - 1 || (batchIdx + 1) % 8 == 0)
+            {
+                u64 epochPosPerSec = settings.batchSize * (batchIdx + 1) * 1000
+                                     / max(millisecondsElapsed(epochStart), (u64)1);
+
+                std::cout << "\rEpoch " << epoch << "/" << settings.epochs
+                          << ", batch " << batchIdx + 1 << "/" << numBatches
+                          << ", epoch train loss " << std::fixed << std::setprecision(4) << totalEpochLoss / (batchIdx + 1)
+                          << ", " << epochPosPerSec << " positions/s" << std::flush;
+            }
+        }
+
+        std::string netFileName = settings.netsFolder + "/netEpoch" + std::to_string(epoch) + ".bin";
+        std::cout << std::endl << "Saving net to " << netFileName << std::endl;
+
+        if (!trainer.saveNet(netFileName)) {
+            std::cout << "Error saving net" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
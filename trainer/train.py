@@ -9,10 +9,16 @@ from torch.utils.data import Dataset, DataLoader
 import json
 from json import JSONEncoder
 import time
+from array import array
+from batch_loader import *
+from net_to_compact import compactMoves4096
 
 INPUT_SIZE = 768
 HIDDEN_SIZE = 32
-OUTPUT_SIZE = 4096
+COMPACT_OUTPUT = False # True to train the compact policy output layer, for engines built with -DPOLICY_COMPACT
+OUTPUT_SIZE = 1792 if COMPACT_OUTPUT else 4096
+OUTPUT_IDXS = {move4096: i for i, move4096 in enumerate(compactMoves4096() if COMPACT_OUTPUT else range(4096))}
+SHARED_TRUNK_NET = None # Set to "../src/value_net.nnue" to train only conn2 on that value net's frozen first layer, for engines built with -DPOLICY_SHARED_TRUNK, else None
 CHECKPOINT = None # Set to "nets/netEpoch15.pth" if resuming training, else None
 START_EPOCH = 1 # Set to 1 if not resuming training
 EPOCHS = 40
@@ -22,7 +28,11 @@ LR_DROP_EPOCH = 20
 LR_DROP_MULTIPLIER = 0.2
 DATALOADER_WORKERS = 11
 DATA_FILE = "1M.bin"
+DATA_HAS_VISITS = False # True for engine datagen files, which also have root visits and game result per entry
 NETS_FOLDER = "nets"
+NATIVE_LOADER_LIB = None # Set to "../converter/batch_loader.so" to load batches with the native loader, else None
+NATIVE_LOADER_FORMAT = FORMAT_DATA_ENTRY # Format of DATA_FILE for the native loader, one of FORMAT_*
+NATIVE_LOADER_THREADS = 4
 
 if torch.cuda.is_available():
     device = torch.device("cuda:0")
@@ -43,12 +53,33 @@ class Net(torch.nn.Module):
             self.conn1.bias.uniform_(-1, 1)
             self.conn2.bias.uniform_(-1, 1)
 
+        if SHARED_TRUNK_NET:
+            self.loadSharedTrunk(SHARED_TRUNK_NET)
+
+    # conn1 becomes the first HIDDEN_SIZE neurons of the value net's feature transformer, divided by QA,
+    # so clamping to [0, 1] matches the engine's clipped and dequantized value accumulator
+    def loadSharedTrunk(self, fileName):
+        VALUE_HIDDEN_SIZE, QA = 128, 181
+        weights = array('h')
+        with open(fileName, 'rb') as file:
+            weights.frombytes(file.read(2 * (INPUT_SIZE * VALUE_HIDDEN_SIZE + VALUE_HIDDEN_SIZE)))
+
+        weights = torch.tensor(weights, dtype=torch.float32)
+        featureWeights = weights[:INPUT_SIZE * VALUE_HIDDEN_SIZE].view(INPUT_SIZE, VALUE_HIDDEN_SIZE)
+        featureBiases = weights[INPUT_SIZE * VALUE_HIDDEN_SIZE:]
+
+        with torch.no_grad():
+            self.conn1.weight.copy_(featureWeights[:, :HIDDEN_SIZE].t() / QA)
+            self.conn1.bias.copy_(featureBiases[:HIDDEN_SIZE] / QA)
+
+        self.conn1.requires_grad_(False)
+
     def forward(self, x, illegals):
         x = x.to(device)
         illegals = illegals.to(device)
 
         x = self.conn1(x)
-        x = torch.relu(x)
+        x = torch.clamp(x, 0, 1) if SHARED_TRUNK_NET else torch.relu(x)
         x = self.conn2(x)
         x[illegals == 1] = -1000000 # Set illegals to -1M
 
@@ -66,6 +97,8 @@ class DataEntry:
     activeInputs: list[ctypes.c_int16()] = field(default_factory=list)
     moves4096: list[ctypes.c_int16()] = field(default_factory=list)
     bestMove4096: ctypes.c_int16() = ctypes.c_int16()
+    visits: list[ctypes.c_uint16()] = field(default_factory=list)
+    result: ctypes.c_int8() = ctypes.c_int8()
 
 class MyDataset(Dataset):
     def __init__(self, fileName, batchSize):
@@ -109,9 +142,18 @@ class MyDataset(Dataset):
 
         illegals = torch.ones(OUTPUT_SIZE)
         for move4096 in entry.moves4096:
-            illegals[move4096] = 0
+            illegals[OUTPUT_IDXS[move4096]] = 0
+
+        if not DATA_HAS_VISITS:
+            return (inputs, illegals, torch.tensor(OUTPUT_IDXS[entry.bestMove4096]))
 
-        return (inputs, illegals, torch.tensor(entry.bestMove4096))
+        # Target is the root visits distribution
+        target = torch.zeros(OUTPUT_SIZE)
+        totalVisits = sum(entry.visits)
+        for move4096, visits in zip(entry.moves4096, entry.visits):
+            target[OUTPUT_IDXS[move4096]] = visits / totalVisits
+
+        return (inputs, illegals, target)
 
     def readEntry(self, file):
         stm = file.read(1)
@@ -143,8 +185,21 @@ class MyDataset(Dataset):
         bestMove4096 = struct.unpack('<H', bestMove4096)[0] # read as u16
         assert bestMove4096 < 4096
 
+        if not DATA_HAS_VISITS:
+            return DataEntry(stm=stm, activeInputs=activeInputs, 
+                moves4096=moves4096, bestMove4096=bestMove4096)
+
+        visits = file.read(numMoves * 2)
+        visits = struct.unpack("<{}H".format(numMoves), visits) # read as u16 list
+        assert sum(visits) > 0
+
+        result = file.read(1)
+        result = struct.unpack('<b', result)[0] # Read as i8
+        assert result >= -1 and result <= 1
+
         return DataEntry(stm=stm, activeInputs=activeInputs, 
-            moves4096=moves4096, bestMove4096=bestMove4096)
+            moves4096=moves4096, bestMove4096=bestMove4096,
+            visits=visits, result=result)
 
 class EncodeTensor(JSONEncoder,Dataset):
     def default(self, obj):
@@ -167,6 +222,9 @@ if __name__ == "__main__":
     print("Nets folder:", NETS_FOLDER)
     print("Dataloader workers:", DATALOADER_WORKERS)
     print("Data file:", DATA_FILE)
+    print("Data has visits:", DATA_HAS_VISITS)
+    print("Native loader:", NATIVE_LOADER_LIB)
+    print("Shared trunk net:", SHARED_TRUNK_NET)
 
     net = Net().to(device)
     if CHECKPOINT != None and CHECKPOINT is not None and CHECKPOINT != "":
@@ -174,18 +232,36 @@ if __name__ == "__main__":
         net.load_state_dict(torch.load(CHECKPOINT))
 
     lossFunction = torch.nn.CrossEntropyLoss()
-    optimizer = torch.optim.Adam(net.parameters(), lr=LR)
-    dataset = MyDataset(DATA_FILE, BATCH_SIZE)
+    optimizer = torch.optim.Adam([param for param in net.parameters() if param.requires_grad], lr=LR)
+
+    if NATIVE_LOADER_LIB:
+        nativeLoader = NativeBatchLoader(NATIVE_LOADER_LIB, DATA_FILE, NATIVE_LOADER_FORMAT,
+            BATCH_SIZE, NATIVE_LOADER_THREADS, compactOutputs=COMPACT_OUTPUT)
+        numBatches = nativeLoader.numBatchesPerEpoch()
+        print("Total positions:", numBatches * BATCH_SIZE)
+        nativeTargetIsVisits = NATIVE_LOADER_FORMAT in [FORMAT_DATA_ENTRY_WITH_VISITS, FORMAT_PACKED_WITH_VISITS]
+    else:
+        dataset = MyDataset(DATA_FILE, BATCH_SIZE)
+
+        dataLoader = torch.utils.data.DataLoader(
+            dataset, 
+            batch_size=BATCH_SIZE, 
+            shuffle=False, 
+            num_workers=DATALOADER_WORKERS, 
+            pin_memory = device != torch.device("cpu"))
+
+        numBatches = len(dataLoader)
+        assert numBatches == len(dataset.batchesPosInFile)
 
-    dataLoader = torch.utils.data.DataLoader(
-        dataset, 
-        batch_size=BATCH_SIZE, 
-        shuffle=False, 
-        num_workers=DATALOADER_WORKERS, 
-        pin_memory = device != torch.device("cpu"))
+    # Yields (inputs, illegals, target) for each batch of an epoch
+    def epochBatches():
+        if not NATIVE_LOADER_LIB:
+            yield from dataLoader
+            return
 
-    numBatches = len(dataLoader)
-    assert numBatches == len(dataset.batchesPosInFile)
+        for _ in range(numBatches):
+            inputs, illegals, bestMoves, targetProbs = nativeLoader.next(device)
+            yield (inputs, illegals, targetProbs if nativeTargetIsVisits else bestMoves)
 
     if not os.path.exists(NETS_FOLDER):
         os.makedirs(NETS_FOLDER)
@@ -201,7 +277,7 @@ if __name__ == "__main__":
                 param_group['lr'] = LR * LR_DROP_MULTIPLIER
             print("LR dropped to {:.8f}".format(LR * LR_DROP_MULTIPLIER))
 
-        for batchIdx, (inputs, illegals, target) in enumerate(dataLoader):
+        for batchIdx, (inputs, illegals, target) in enumerate(epochBatches()):
             target = target.to(device)
             optimizer.zero_grad(set_to_none=True)
             outputs = net(inputs, illegals)